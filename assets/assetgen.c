@@ -0,0 +1,282 @@
+/***************************************************************************************************//**
+*  \file       assetgen.c
+*
+*  \details    Host tool: turns PBM bitmaps into PackBits compressed, page-major OLED assets
+*
+*  \author     Frank
+*
+*  Usage: assetgen logo.pbm ... > oled_assets.h      built-in assets of the driver
+*         assetgen -f logo.pbm > logo.oled           firmware file for request_firmware()
+*
+*  The PBM (P1 text or P4 binary, at most 132x64, 1 = lit) is turned into
+*  the SH1106/SSD1315 RAM order: page by page, one byte per column with
+*  bit 0 the top row of the page. A height that is not a multiple of 8 is
+*  padded with blank rows. The page-major bytes are PackBits encoded:
+*
+*    n = 0..127      n + 1 literal bytes follow
+*    n = -127..-1    the next byte, repeated 1 - n times
+*    n = -128        no-op
+*
+*  A firmware file is "OLED", width, pages, then the PackBits stream; a
+*  built-in asset carries the same fields in struct oled_asset. The asset
+*  name is the file name without directory and extension.
+*
+******************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define MAX_WIDTH       ( 132 )
+#define MAX_PAGES       (   8 )
+#define MAX_RAW         ( MAX_WIDTH * MAX_PAGES )
+#define MAX_PACKED      ( MAX_RAW + ( MAX_RAW / 128 ) + 1 )
+#define MAX_ASSETS      (  16 )
+
+struct asset
+{
+  char          name[32];
+  int           width;
+  int           pages;
+  unsigned char raw[MAX_RAW];
+  unsigned char packed[MAX_PACKED];
+  int           len;                            // bytes used in packed
+};
+
+static struct asset assets[MAX_ASSETS];
+
+static void die(const char *path, const char *msg)
+{
+  fprintf(stderr, "assetgen: %s: %s\n", path, msg);
+  exit(1);
+}
+
+/* next header number of a PBM, skipping white space and # comments */
+static int pbm_number(FILE *fp, const char *path)
+{
+  int c;
+  int n = 0;
+
+  for( ;; )
+  {
+    c = fgetc(fp);
+    if( c == '#' )
+    {
+      while( ( c != '\n' ) && ( c != EOF ) )
+      {
+        c = fgetc(fp);
+      }
+    }
+    if( c == EOF )
+    {
+      die(path, "truncated header");
+    }
+    if( isdigit(c) )
+    {
+      break;
+    }
+    if( !isspace(c) )
+    {
+      die(path, "bad header");
+    }
+  }
+
+  while( isdigit(c) )
+  {
+    n = ( n * 10 ) + ( c - '0' );
+    c = fgetc(fp);
+  }
+
+  return n;
+}
+
+static void parse(const char *path, struct asset *a)
+{
+  const char *base;
+  const char *dot;
+  FILE       *fp;
+  char        magic[3] = { 0 };
+  int         height;
+  int         x, y;
+  int         c = 0;
+  int         bit;
+
+  base = strrchr(path, '/');
+  base = base ? base + 1 : path;
+  dot  = strchr(base, '.');
+  if( ( dot ? dot - base : (long)strlen(base) ) >= (long)sizeof(a->name) )
+  {
+    die(path, "file name too long");
+  }
+  memcpy(a->name, base, dot ? (size_t)( dot - base ) : strlen(base));
+  for( x = 0; a->name[x]; x++ )
+  {
+    if( !isalnum((unsigned char)a->name[x]) && ( a->name[x] != '_' ) )
+    {
+      die(path, "asset names are [A-Za-z0-9_]");
+    }
+  }
+
+  fp = fopen(path, "rb");
+  if( !fp )
+  {
+    die(path, "cannot open");
+  }
+  if( ( fread(magic, 1, 2, fp) != 2 ) || ( strcmp(magic, "P1") && strcmp(magic, "P4") ) )
+  {
+    die(path, "not a P1/P4 PBM");
+  }
+
+  a->width = pbm_number(fp, path);
+  height   = pbm_number(fp, path);
+  if( ( a->width < 1 ) || ( a->width > MAX_WIDTH ) || ( height < 1 ) || ( height > MAX_PAGES * 8 ) )
+  {
+    die(path, "size must be within 132x64");
+  }
+  a->pages = ( height + 7 ) / 8;
+
+  //P4: the single white space after the height was eaten by pbm_number()
+  for( y = 0; y < height; y++ )
+  {
+    for( x = 0; x < a->width; x++ )
+    {
+      if( magic[1] == '4' )
+      {
+        if( ( x % 8 ) == 0 )
+        {
+          c = fgetc(fp);
+        }
+        bit = ( c >> ( 7 - ( x % 8 ) ) ) & 1;
+      }
+      else
+      {
+        do
+        {
+          c = fgetc(fp);
+        } while( isspace(c) );
+        bit = c - '0';
+      }
+      if( ( c == EOF ) || ( bit < 0 ) || ( bit > 1 ) )
+      {
+        die(path, "truncated or bad pixel data");
+      }
+      a->raw[( ( y / 8 ) * a->width ) + x] |= bit << ( y % 8 );
+    }
+  }
+
+  fclose(fp);
+}
+
+/* PackBits: runs of 3 or more are repeats, everything else literals */
+static void pack(struct asset *a)
+{
+  const unsigned char *in  = a->raw;
+  int                  n   = a->width * a->pages;
+  int                  i   = 0;
+  int                  lit = -1;                  // index of the open literal header
+  int                  run;
+
+  a->len = 0;
+  while( i < n )
+  {
+    for( run = 1; ( i + run < n ) && ( in[i + run] == in[i] ) && ( run < 128 ); run++ );
+
+    if( run >= 3 )
+    {
+      a->packed[a->len++] = (unsigned char)( 1 - run );
+      a->packed[a->len++] = in[i];
+      i  += run;
+      lit = -1;
+    }
+    else
+    {
+      if( ( lit < 0 ) || ( a->packed[lit] == 127 ) )
+      {
+        lit = a->len++;
+        a->packed[lit] = (unsigned char)-1;
+      }
+      a->packed[lit]++;
+      a->packed[a->len++] = in[i++];
+    }
+  }
+}
+
+static void emit_header(int n)
+{
+  int i, k;
+
+  printf("/* generated by assets/assetgen from the assets/<name>.pbm sources, do not edit */\n"
+         "#ifndef OLED_ASSETS_H\n"
+         "#define OLED_ASSETS_H\n"
+         "\n"
+         "/*\n"
+         "** Built-in bitmaps: PackBits streams that decode to width * pages bytes\n"
+         "** in panel RAM order (page by page, one byte per column, bit 0 = top\n"
+         "** row of the page). A firmware file holds the same: OLED_ASSET_MAGIC,\n"
+         "** width, pages, then the stream.\n"
+         "*/\n"
+         "#define OLED_ASSET_MAGIC        \"OLED\"\n"
+         "#define OLED_ASSET_HDR_SIZE     ( 6 )\n"
+         "\n"
+         "struct oled_asset\n"
+         "{\n"
+         "  const char          *name;\n"
+         "  const unsigned char *data;                    // PackBits stream\n"
+         "  unsigned short       len;                     // bytes in data\n"
+         "  unsigned char        width;                   // columns\n"
+         "  unsigned char        pages;                   // rows / 8\n"
+         "};\n");
+
+  for( i = 0; i < n; i++ )
+  {
+    printf("\n/* %s: %dx%d, %d bytes packed from %d */\n", assets[i].name,
+           assets[i].width, assets[i].pages * 8, assets[i].len, assets[i].width * assets[i].pages);
+    printf("static const unsigned char oled_asset_%s[%d] =\n{", assets[i].name, assets[i].len);
+    for( k = 0; k < assets[i].len; k++ )
+    {
+      printf("%s0x%02x,", ( ( k % 16 ) == 0 ) ? "\n  " : " ", assets[i].packed[k]);
+    }
+    printf("\n};\n");
+  }
+
+  printf("\n#define OLED_NR_ASSETS          ( %d )\n", n);
+  printf("\nstatic const struct oled_asset oled_assets[OLED_NR_ASSETS] =\n{\n");
+  for( i = 0; i < n; i++ )
+  {
+    printf("  { \"%s\", oled_asset_%s, %d, %d, %d },\n",
+           assets[i].name, assets[i].name, assets[i].len, assets[i].width, assets[i].pages);
+  }
+  printf("};\n\n#endif /* OLED_ASSETS_H */\n");
+}
+
+int main(int argc, char **argv)
+{
+  int i;
+
+  if( ( argc == 3 ) && ( strcmp(argv[1], "-f") == 0 ) )
+  {
+    parse(argv[2], &assets[0]);
+    pack(&assets[0]);
+    fwrite("OLED", 1, 4, stdout);
+    putchar(assets[0].width);
+    putchar(assets[0].pages);
+    fwrite(assets[0].packed, 1, assets[0].len, stdout);
+    return 0;
+  }
+
+  if( ( argc < 2 ) || ( argc > MAX_ASSETS + 1 ) || ( argv[1][0] == '-' ) )
+  {
+    fprintf(stderr, "usage: assetgen image.pbm... (up to %d) > oled_assets.h\n"
+                    "       assetgen -f image.pbm > image.oled\n", MAX_ASSETS);
+    return 1;
+  }
+
+  for( i = 1; i < argc; i++ )
+  {
+    parse(argv[i], &assets[i - 1]);
+    pack(&assets[i - 1]);
+  }
+  emit_header(argc - 1);
+
+  return 0;
+}
@@ -0,0 +1,281 @@
+/***************************************************************************************************//**
+*  \file       fontgen.c
+*
+*  \details    Host tool: turns the font_*.txt sources into oled_fonts.h (page-major glyph tables)
+*
+*  \author     Frank
+*
+*  Usage: fontgen font_5x7.txt font_8x16.txt ... > oled_fonts.h
+*
+*  A source file is
+*
+*    // comment
+*    size <width> <height>       height a multiple of 8 (one page = 8 rows)
+*    spacing <columns>           blank columns after a fixed width cell
+*    glyph 0x20 ...              then <height> rows of <width> chars, '#' = lit
+*
+*  with the glyphs 0x20..0x7e in order. The tables come out in the order
+*  the SH1106/SSD1315 RAM takes them: glyph by glyph, page by page, one
+*  byte per column with bit 0 the top row of the page, so the drivers copy
+*  each page of a glyph straight into their shadow buffer. For the
+*  proportional mode the first and the number of inked columns of every
+*  glyph are computed here as well.
+*
+******************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define FIRST_CHAR      ( 0x20 )
+#define NR_CHARS        ( 0x7f - FIRST_CHAR )
+#define MAX_WIDTH       ( 32 )
+#define MAX_HEIGHT      ( 64 )
+
+struct font
+{
+  char          name[32];                       // from the file name: font_8x16.txt -> 8x16
+  int           width;
+  int           height;
+  int           spacing;
+  unsigned char rows[NR_CHARS][MAX_HEIGHT][MAX_WIDTH];
+};
+
+static struct font font;
+
+static void die(const char *path, int line, const char *msg)
+{
+  fprintf(stderr, "fontgen: %s:%d: %s\n", path, line, msg);
+  exit(1);
+}
+
+static void parse(const char *path)
+{
+  const char *base;
+  const char *dot;
+  char        buf[256];
+  FILE       *fp;
+  int         line  = 0;
+  int         glyph = -1;
+  int         row   = 0;
+  int         len;
+  int         i;
+
+  memset(&font, 0, sizeof(font));
+
+  base = strrchr(path, '/');
+  base = base ? base + 1 : path;
+  if( strncmp(base, "font_", 5) == 0 )
+  {
+    base += 5;
+  }
+  dot = strchr(base, '.');
+  len = dot ? (int)( dot - base ) : (int)strlen(base);
+  if( len >= (int)sizeof(font.name) )
+  {
+    die(path, 0, "file name too long");
+  }
+  memcpy(font.name, base, len);
+
+  fp = fopen(path, "r");
+  if( !fp )
+  {
+    die(path, 0, "cannot open");
+  }
+
+  while( fgets(buf, sizeof(buf), fp) )
+  {
+    line++;
+    buf[strcspn(buf, "\r\n")] = '\0';
+
+    if( ( strncmp(buf, "//", 2) == 0 ) || ( buf[0] == '\0' ) )
+    {
+      continue;
+    }
+
+    if( sscanf(buf, "size %d %d", &font.width, &font.height) == 2 )
+    {
+      if( ( font.width < 1 ) || ( font.width > MAX_WIDTH ) ||
+          ( font.height < 8 ) || ( font.height > MAX_HEIGHT ) || ( font.height % 8 ) )
+      {
+        die(path, line, "bad size");
+      }
+      continue;
+    }
+
+    if( sscanf(buf, "spacing %d", &font.spacing) == 1 )
+    {
+      continue;
+    }
+
+    if( strncmp(buf, "glyph ", 6) == 0 )
+    {
+      if( ( glyph >= 0 ) && ( row != font.height ) )
+      {
+        die(path, line, "previous glyph is short");
+      }
+      if( strtol(buf + 6, NULL, 0) != FIRST_CHAR + glyph + 1 )
+      {
+        die(path, line, "glyphs must be 0x20..0x7e in order");
+      }
+      if( !font.width )
+      {
+        die(path, line, "glyph before size");
+      }
+      glyph++;
+      row = 0;
+      continue;
+    }
+
+    if( ( glyph < 0 ) || ( row >= font.height ) || ( (int)strlen(buf) != font.width ) )
+    {
+      die(path, line, "bad glyph row");
+    }
+    for( i = 0; i < font.width; i++ )
+    {
+      font.rows[glyph][row][i] = ( buf[i] == '#' );
+    }
+    row++;
+  }
+
+  fclose(fp);
+
+  if( ( glyph != NR_CHARS - 1 ) || ( row != font.height ) )
+  {
+    die(path, line, "glyphs 0x20..0x7e expected");
+  }
+}
+
+static void emit(void)
+{
+  int pages = font.height / 8;
+  int g, p, x, y;
+  int first, last;
+  unsigned char byte;
+
+  printf("\nstatic const unsigned char oled_font_%s_glyphs[%d * %d * %d] =\n{\n",
+         font.name, NR_CHARS, pages, font.width);
+  for( g = 0; g < NR_CHARS; g++ )
+  {
+    printf("  ");
+    for( p = 0; p < pages; p++ )
+    {
+      for( x = 0; x < font.width; x++ )
+      {
+        byte = 0;
+        for( y = 0; y < 8; y++ )
+        {
+          byte |= font.rows[g][( p * 8 ) + y][x] << y;
+        }
+        printf("0x%02x,", byte);
+      }
+      printf(( p + 1 < pages ) ? " " : "");
+    }
+    //no backslash at the end of a // comment: it would continue on the next line
+    printf("   // 0x%02x %c\n", FIRST_CHAR + g, ( FIRST_CHAR + g == '\\' ) ? ' ' : FIRST_CHAR + g);
+  }
+  printf("};\n");
+
+  /* proportional: inked columns of each glyph (blank glyphs: half a cell) */
+  printf("\nstatic const unsigned char oled_font_%s_left[%d] =\n{\n ", font.name, NR_CHARS);
+  for( g = 0; g < NR_CHARS; g++ )
+  {
+    for( first = 0; first < font.width; first++ )
+    {
+      for( y = 0; ( y < font.height ) && !font.rows[g][y][first]; y++ );
+      if( y < font.height ) break;
+    }
+    printf(" %d,%s", ( first < font.width ) ? first : 0, ( ( g % 16 ) == 15 ) ? "\n " : "");
+  }
+  printf("\n};\n");
+
+  printf("\nstatic const unsigned char oled_font_%s_ink[%d] =\n{\n ", font.name, NR_CHARS);
+  for( g = 0; g < NR_CHARS; g++ )
+  {
+    for( first = 0; first < font.width; first++ )
+    {
+      for( y = 0; ( y < font.height ) && !font.rows[g][y][first]; y++ );
+      if( y < font.height ) break;
+    }
+    for( last = font.width - 1; last > first; last-- )
+    {
+      for( y = 0; ( y < font.height ) && !font.rows[g][y][last]; y++ );
+      if( y < font.height ) break;
+    }
+    printf(" %d,%s", ( first < font.width ) ? ( last - first + 1 ) : ( ( font.width + 1 ) / 2 ),
+           ( ( g % 16 ) == 15 ) ? "\n " : "");
+  }
+  printf("\n};\n");
+}
+
+int main(int argc, char **argv)
+{
+  char names[8][32];
+  int  w[8], pg[8], sp[8];
+  int  i, n;
+
+  if( ( argc < 2 ) || ( argc > 9 ) )
+  {
+    fprintf(stderr, "usage: fontgen font_WxH.txt... (up to 8) > oled_fonts.h\n");
+    return 1;
+  }
+
+  printf("/* generated by fonts/fontgen from the fonts/font_*.txt sources, do not edit */\n"
+         "#ifndef OLED_FONTS_H\n"
+         "#define OLED_FONTS_H\n"
+         "\n"
+         "/*\n"
+         "** Glyph tables in panel RAM order: glyph by glyph, page by page, one byte\n"
+         "** per column, bit 0 = top row of the page. A glyph of a font two pages\n"
+         "** tall is the columns of its top page, then those of its bottom page.\n"
+         "** left/ink give the inked columns of each glyph (proportional mode).\n"
+         "*/\n"
+         "struct oled_font\n"
+         "{\n"
+         "  const char          *name;\n"
+         "  const unsigned char *glyphs;                  // count * pages * width bytes\n"
+         "  const unsigned char *left;                    // first inked column of each glyph\n"
+         "  const unsigned char *ink;                     // inked columns of each glyph\n"
+         "  unsigned char        width;                   // cell width, columns\n"
+         "  unsigned char        pages;                   // cell height, pages\n"
+         "  unsigned char        spacing;                 // blank columns after a fixed width cell\n"
+         "  unsigned char        first;                   // first char of the table\n"
+         "  unsigned char        count;                   // chars in the table\n"
+         "};\n");
+
+  for( n = 0; n < argc - 1; n++ )
+  {
+    parse(argv[1 + n]);
+    emit();
+
+    memcpy(names[n], font.name, sizeof(names[n]));
+    w[n]  = font.width;
+    pg[n] = font.height / 8;
+    sp[n] = font.spacing;
+  }
+
+  printf("\nenum oled_font_id\n{\n");
+  for( i = 0; i < n; i++ )
+  {
+    char upper[32];
+    int  k;
+
+    for( k = 0; names[i][k]; k++ )
+    {
+      upper[k] = toupper((unsigned char)names[i][k]);
+    }
+    upper[k] = '\0';
+    printf("  OLED_FONT_%s,\n", upper);
+  }
+  printf("  OLED_NR_FONTS\n};\n");
+
+  printf("\nstatic const struct oled_font oled_fonts[OLED_NR_FONTS] =\n{\n");
+  for( i = 0; i < n; i++ )
+  {
+    printf("  { \"%s\", oled_font_%s_glyphs, oled_font_%s_left, oled_font_%s_ink, %d, %d, %d, 0x%02x, %d },\n",
+           names[i], names[i], names[i], names[i], w[i], pg[i], sp[i], FIRST_CHAR, NR_CHARS);
+  }
+  printf("};\n\n#endif /* OLED_FONTS_H */\n");
+
+  return 0;
+}
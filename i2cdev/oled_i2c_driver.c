@@ -21,6 +21,12 @@
 #include <linux/err.h>
 #include <linux/i2c.h>
 #include <linux/i2c-dev.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/of.h>
+
+/* glyph tables, generated from fonts/font_*.txt by fonts/fontgen (see Makefile) */
+#include "oled_fonts.h"
 
 /* print */
 #undef pr_fmt
@@ -29,8 +35,28 @@
 #define OLED_I2C_NAME           "oled_ssd1315"
 #define OLED_I2C_SLAVE_ADDR     0x3c
 #define OLED_I2C_BUS_AVAILABLE  1
+#define OLED_I2C_MAX_PANELS     4
+
+/* the SA0 pin of the SSD1315 selects one of these two addresses */
+static const unsigned short oled_i2c_addrs[] = { 0x3c, 0x3d, I2C_CLIENT_END };
+
+/*
+** The panels are normally described in the device tree (compatible
+** "solomon,ssd1315", reg 0x3c or 0x3d, on any adapter) or in ACPI through
+** PRP0001 with the same compatible, and the driver core probes them.
+** For boards without such a description, panels can be created at module
+** load: panel N sits at frk_i2c_addr[N] on bus frk_i2c_bus[N]; address 0
+** probes 0x3c then 0x3d on that bus.
+*/
+static int            frk_i2c_nr_panels;
+static unsigned short frk_i2c_addr[OLED_I2C_MAX_PANELS];
+static int            frk_i2c_bus[OLED_I2C_MAX_PANELS]  = { [0 ... OLED_I2C_MAX_PANELS - 1] = OLED_I2C_BUS_AVAILABLE };
+module_param_array(frk_i2c_addr, ushort, &frk_i2c_nr_panels, 0444);
+MODULE_PARM_DESC(frk_i2c_addr, "I2C address of each panel created by hand (0 = scan 0x3c/0x3d)");
+module_param_array(frk_i2c_bus, int, NULL, 0444);
+MODULE_PARM_DESC(frk_i2c_bus, "I2C bus of each panel created by hand (default 1)");
 
-static struct i2c_client* oled_client;
+static struct i2c_client* oled_clients[OLED_I2C_MAX_PANELS];
 
 static struct i2c_board_info oled_info = {
     I2C_BOARD_INFO(OLED_I2C_NAME, OLED_I2C_SLAVE_ADDR)
@@ -42,131 +68,121 @@ static struct i2c_board_info oled_info = {
 
 #define SSD1315_MAX_SEG         (        128 )              // Maximum segment
 #define SSD1315_MAX_LINE        (          7 )              // Maximum line
+#define SSD1315_MAX_PAGE        (          8 )              // Number of pages (lines)
 #define SSD1315_DEF_FONT_SIZE   (          5 )              // Default font size
+#define SSD1315_BURST_MAX       ( SSD1315_MAX_PAGE * SSD1315_MAX_SEG )  // longest burst: a full frame
 
-static uint8_t SSD1315_LineNum   = 0;
-static uint8_t SSD1315_CursorPos = 0;
-static uint8_t SSD1315_FontSize  = SSD1315_DEF_FONT_SIZE;
+/*
+** Bus transport, picked in probe from the adapter functionality, fastest
+** first: raw I2C bursts, SMBus I2C block writes (32 byte chunks), SMBus
+** byte writes. The control byte is the SMBus command byte.
+*/
+enum ssd1315_xfer
+{
+  SSD1315_XFER_I2C = 0,
+  SSD1315_XFER_SMBUS_BLOCK,
+  SSD1315_XFER_SMBUS_BYTE,
+};
 
-static void SSD1315_Fill(unsigned char data);
+static const char * const SSD1315_XferNames[] =
+{
+  [SSD1315_XFER_I2C]         = "i2c",
+  [SSD1315_XFER_SMBUS_BLOCK] = "smbus-block",
+  [SSD1315_XFER_SMBUS_BYTE]  = "smbus-byte",
+};
 
-/******************************************************************************************************/
-/* OLED EED1315 APIs, from EmbedTronix */
+/*
+** Per-panel state, allocated in probe and kept as the client data, so
+** every address/bus gets its own cursor, shadow framebuffer and lock.
+** The bus traffic (init and flushes) runs on the panel's own ordered
+** workqueue: panels on different adapters flush in parallel and the
+** drawing callers don't wait for the bus.
+**
+** Shadow framebuffer (128x64, one byte per segment per page) and the panel
+** RAM as the last flush left it. SSD1315_Flush() diffs the dirty pages
+** against panel->sent and only sends the changed column windows; pages in
+** panel->full_pages are sent whole (panel RAM unknown after power-up).
+*/
+struct ssd1315_panel
+{
+  struct i2c_client *client;
+  enum ssd1315_xfer  xfer;                                  // bus transport
+  struct mutex       lock;                                  // draw + flush sequences
+
+  uint8_t            line_num;
+  uint8_t            cursor_pos;
+  uint8_t            font_size;
 
-static const unsigned char SSD1315_font[][SSD1315_DEF_FONT_SIZE]= 
-{
-    {0x00, 0x00, 0x00, 0x00, 0x00},   // space
-    {0x00, 0x00, 0x2f, 0x00, 0x00},   // !
-    {0x00, 0x07, 0x00, 0x07, 0x00},   // "
-    {0x14, 0x7f, 0x14, 0x7f, 0x14},   // #
-    {0x24, 0x2a, 0x7f, 0x2a, 0x12},   // $
-    {0x23, 0x13, 0x08, 0x64, 0x62},   // %
-    {0x36, 0x49, 0x55, 0x22, 0x50},   // &
-    {0x00, 0x05, 0x03, 0x00, 0x00},   // '
-    {0x00, 0x1c, 0x22, 0x41, 0x00},   // (
-    {0x00, 0x41, 0x22, 0x1c, 0x00},   // )
-    {0x14, 0x08, 0x3E, 0x08, 0x14},   // *
-    {0x08, 0x08, 0x3E, 0x08, 0x08},   // +
-    {0x00, 0x00, 0xA0, 0x60, 0x00},   // ,
-    {0x08, 0x08, 0x08, 0x08, 0x08},   // -
-    {0x00, 0x60, 0x60, 0x00, 0x00},   // .
-    {0x20, 0x10, 0x08, 0x04, 0x02},   // /
-    {0x3E, 0x51, 0x49, 0x45, 0x3E},   // 0
-    {0x00, 0x42, 0x7F, 0x40, 0x00},   // 1
-    {0x42, 0x61, 0x51, 0x49, 0x46},   // 2
-    {0x21, 0x41, 0x45, 0x4B, 0x31},   // 3
-    {0x18, 0x14, 0x12, 0x7F, 0x10},   // 4
-    {0x27, 0x45, 0x45, 0x45, 0x39},   // 5
-    {0x3C, 0x4A, 0x49, 0x49, 0x30},   // 6
-    {0x01, 0x71, 0x09, 0x05, 0x03},   // 7
-    {0x36, 0x49, 0x49, 0x49, 0x36},   // 8
-    {0x06, 0x49, 0x49, 0x29, 0x1E},   // 9
-    {0x00, 0x36, 0x36, 0x00, 0x00},   // :
-    {0x00, 0x56, 0x36, 0x00, 0x00},   // ;
-    {0x08, 0x14, 0x22, 0x41, 0x00},   // <
-    {0x14, 0x14, 0x14, 0x14, 0x14},   // =
-    {0x00, 0x41, 0x22, 0x14, 0x08},   // >
-    {0x02, 0x01, 0x51, 0x09, 0x06},   // ?
-    {0x32, 0x49, 0x59, 0x51, 0x3E},   // @
-    {0x7C, 0x12, 0x11, 0x12, 0x7C},   // A
-    {0x7F, 0x49, 0x49, 0x49, 0x36},   // B
-    {0x3E, 0x41, 0x41, 0x41, 0x22},   // C
-    {0x7F, 0x41, 0x41, 0x22, 0x1C},   // D
-    {0x7F, 0x49, 0x49, 0x49, 0x41},   // E
-    {0x7F, 0x09, 0x09, 0x09, 0x01},   // F
-    {0x3E, 0x41, 0x49, 0x49, 0x7A},   // G
-    {0x7F, 0x08, 0x08, 0x08, 0x7F},   // H
-    {0x00, 0x41, 0x7F, 0x41, 0x00},   // I
-    {0x20, 0x40, 0x41, 0x3F, 0x01},   // J
-    {0x7F, 0x08, 0x14, 0x22, 0x41},   // K
-    {0x7F, 0x40, 0x40, 0x40, 0x40},   // L
-    {0x7F, 0x02, 0x0C, 0x02, 0x7F},   // M
-    {0x7F, 0x04, 0x08, 0x10, 0x7F},   // N
-    {0x3E, 0x41, 0x41, 0x41, 0x3E},   // O
-    {0x7F, 0x09, 0x09, 0x09, 0x06},   // P
-    {0x3E, 0x41, 0x51, 0x21, 0x5E},   // Q
-    {0x7F, 0x09, 0x19, 0x29, 0x46},   // R
-    {0x46, 0x49, 0x49, 0x49, 0x31},   // S
-    {0x01, 0x01, 0x7F, 0x01, 0x01},   // T
-    {0x3F, 0x40, 0x40, 0x40, 0x3F},   // U
-    {0x1F, 0x20, 0x40, 0x20, 0x1F},   // V
-    {0x3F, 0x40, 0x38, 0x40, 0x3F},   // W
-    {0x63, 0x14, 0x08, 0x14, 0x63},   // X
-    {0x07, 0x08, 0x70, 0x08, 0x07},   // Y
-    {0x61, 0x51, 0x49, 0x45, 0x43},   // Z
-    {0x00, 0x7F, 0x41, 0x41, 0x00},   // [
-    {0x55, 0xAA, 0x55, 0xAA, 0x55},   // Backslash (Checker pattern)
-    {0x00, 0x41, 0x41, 0x7F, 0x00},   // ]
-    {0x04, 0x02, 0x01, 0x02, 0x04},   // ^
-    {0x40, 0x40, 0x40, 0x40, 0x40},   // _
-    {0x00, 0x03, 0x05, 0x00, 0x00},   // `
-    {0x20, 0x54, 0x54, 0x54, 0x78},   // a
-    {0x7F, 0x48, 0x44, 0x44, 0x38},   // b
-    {0x38, 0x44, 0x44, 0x44, 0x20},   // c
-    {0x38, 0x44, 0x44, 0x48, 0x7F},   // d
-    {0x38, 0x54, 0x54, 0x54, 0x18},   // e
-    {0x08, 0x7E, 0x09, 0x01, 0x02},   // f
-    {0x18, 0xA4, 0xA4, 0xA4, 0x7C},   // g
-    {0x7F, 0x08, 0x04, 0x04, 0x78},   // h
-    {0x00, 0x44, 0x7D, 0x40, 0x00},   // i
-    {0x40, 0x80, 0x84, 0x7D, 0x00},   // j
-    {0x7F, 0x10, 0x28, 0x44, 0x00},   // k
-    {0x00, 0x41, 0x7F, 0x40, 0x00},   // l
-    {0x7C, 0x04, 0x18, 0x04, 0x78},   // m
-    {0x7C, 0x08, 0x04, 0x04, 0x78},   // n
-    {0x38, 0x44, 0x44, 0x44, 0x38},   // o
-    {0xFC, 0x24, 0x24, 0x24, 0x18},   // p
-    {0x18, 0x24, 0x24, 0x18, 0xFC},   // q
-    {0x7C, 0x08, 0x04, 0x04, 0x08},   // r
-    {0x48, 0x54, 0x54, 0x54, 0x20},   // s
-    {0x04, 0x3F, 0x44, 0x40, 0x20},   // t
-    {0x3C, 0x40, 0x40, 0x20, 0x7C},   // u
-    {0x1C, 0x20, 0x40, 0x20, 0x1C},   // v
-    {0x3C, 0x40, 0x30, 0x40, 0x3C},   // w
-    {0x44, 0x28, 0x10, 0x28, 0x44},   // x
-    {0x1C, 0xA0, 0xA0, 0xA0, 0x7C},   // y
-    {0x44, 0x64, 0x54, 0x4C, 0x44},   // z
-    {0x00, 0x10, 0x7C, 0x82, 0x00},   // {
-    {0x00, 0x00, 0xFF, 0x00, 0x00},   // |
-    {0x00, 0x82, 0x7C, 0x10, 0x00},   // }
-    {0x00, 0x06, 0x09, 0x09, 0x06}    // ~ (Degrees)
+  uint8_t            buffer[SSD1315_MAX_PAGE][SSD1315_MAX_SEG];
+  uint8_t            sent[SSD1315_MAX_PAGE][SSD1315_MAX_SEG];
+  uint8_t            dirty_pages;
+  uint8_t            full_pages;
+  unsigned long      delta_saved;                           // bytes not sent thanks to the delta encoding
+
+  /*
+  ** Controller address pointer. In horizontal addressing mode it walks the
+  ** 0x21/0x22 window column by column, then page by page, and wraps to the
+  ** window start. A run starting where the last one stopped goes out as
+  ** plain data, without window commands. hw_valid is cleared while the
+  ** controller state is unknown (init, failed transfer).
+  */
+  bool               hw_valid;
+  uint8_t            hw_page_start, hw_page_end;
+  uint8_t            hw_col_start, hw_col_end;
+  uint8_t            hw_page, hw_col;
+
+  unsigned char      tx[1 + SSD1315_BURST_MAX];             // control byte + burst
+  unsigned char      win[1 + 6];                            // control byte + window commands
+
+  bool               ready;                                 // init sequence sent
+  struct workqueue_struct *wq;
+  struct work_struct flush_work;
+
+  /*
+  ** Console: the screen shows RAM from the display start line on, so the
+  ** lines scroll up by moving the start line (0x40 | row) instead of being
+  ** redrawn. con_top is the RAM page at the top of the screen, con_rows
+  ** the lines in use. A new line on a full screen overwrites page con_top
+  ** and moves the start line one page down: one page write and one
+  ** command per scrolled line.
+  */
+  uint8_t            con_top;
+  uint8_t            con_rows;
+  bool               con_newline;                           // next char starts a new line
+  uint8_t            start_line;                            // display start line wanted
+  uint8_t            hw_start_line;                         // display start line on the controller
 };
 
-static int I2C_Write(unsigned char *buf, unsigned int len)
+/*
+** A new window costs a command message (address, control, 0x21 s e 0x22
+** p p) and the address and control byte of a new data message, chained
+** in the same i2c_transfer(): shorter unchanged gaps are sent.
+*/
+#define SSD1315_WINDOW_COST     ( ( 2 + 6 ) + 2 )
+#define SSD1315_FRAME_SIZE      ( SSD1315_MAX_PAGE * SSD1315_MAX_SEG )
+
+static void SSD1315_Fill(struct ssd1315_panel *panel, unsigned char data);
+
+/******************************************************************************************************/
+/* OLED EED1315 APIs, from EmbedTronix */
+
+static int I2C_Write(struct ssd1315_panel *panel, unsigned char *buf, unsigned int len)
 {
-  int ret = i2c_master_send(oled_client, buf, len);
+  int ret = i2c_master_send(panel->client, buf, len);
   
   return ret;
 }
 
-static int I2C_Read(unsigned char *out_buf, unsigned int len)
+static int I2C_Read(struct ssd1315_panel *panel, unsigned char *out_buf, unsigned int len)
 {
-  int ret = i2c_master_recv(oled_client, out_buf, len);
+  int ret = i2c_master_recv(panel->client, out_buf, len);
   
   return ret;
 }
 
-static void SSD1315_Write(bool is_cmd, unsigned char data)
+static int SSD1315_Burst(struct ssd1315_panel *panel, unsigned char ctrl, const unsigned char *data, unsigned int len);
+
+static void SSD1315_Write(struct ssd1315_panel *panel, bool is_cmd, unsigned char data)
 {
   unsigned char buf[2] = {0};
   int ret;
@@ -182,35 +198,194 @@ static void SSD1315_Write(bool is_cmd, unsigned char data)
   
   buf[1] = data;
   
-  ret = I2C_Write(buf, 2);
+  ret = SSD1315_Burst(panel, buf[0], &buf[1], 1);
 }
 
 
-static void SSD1315_SetCursor( uint8_t lineNo, uint8_t cursorPos )
+/*
+** Sends the control byte followed by len bytes in one transaction. The
+** burst is only split when the adapter has a max_write_len quirk shorter
+** than that; each chunk then starts with the control byte again.
+** On SMBus adapters the chunks are I2C block writes (32 bytes) or single
+** byte writes.
+** ctrl: 0x00 for a command stream, 0x40 for a data stream.
+*/
+static int SSD1315_Burst(struct ssd1315_panel *panel, unsigned char ctrl, const unsigned char *data, unsigned int len)
+{
+  const struct i2c_adapter_quirks *quirks = panel->client->adapter->quirks;
+  unsigned int  max = SSD1315_BURST_MAX;
+  unsigned int  chunk;
+  int           ret = 0;
+
+  if( panel->xfer == SSD1315_XFER_SMBUS_BLOCK )
+  {
+    max = I2C_SMBUS_BLOCK_MAX;
+  }
+  else if( panel->xfer == SSD1315_XFER_SMBUS_BYTE )
+  {
+    max = 1;
+  }
+  else if( quirks && quirks->max_write_len && ( quirks->max_write_len - 1u < max ) )
+  {
+    max = quirks->max_write_len - 1u;
+  }
+
+  //a write with room for the control byte only can't carry any data
+  if( max == 0 )
+  {
+    return -EOPNOTSUPP;
+  }
+
+  while( len > 0 )
+  {
+    chunk = min(len, max);
+
+    switch( panel->xfer )
+    {
+      case SSD1315_XFER_SMBUS_BLOCK:
+        ret = i2c_smbus_write_i2c_block_data(panel->client, ctrl, chunk, data);
+        break;
+
+      case SSD1315_XFER_SMBUS_BYTE:
+        ret = i2c_smbus_write_byte_data(panel->client, ctrl, *data);
+        break;
+
+      default:
+        panel->tx[0] = ctrl;
+        memcpy(&panel->tx[1], data, chunk);
+
+        ret = I2C_Write(panel, panel->tx, 1 + chunk);
+        break;
+    }
+    if( ret < 0 )
+    {
+      return ret;
+    }
+
+    data += chunk;
+    len  -= chunk;
+  }
+
+  return 0;
+}
+
+/* command sequence as one 0x00 burst */
+static int SSD1315_WriteCmds(struct ssd1315_panel *panel, const unsigned char *cmds, unsigned int len)
+{
+  return SSD1315_Burst(panel, 0x00, cmds, len);
+}
+
+/* data (GDDRAM bytes) as one 0x40 burst */
+static int SSD1315_WriteData(struct ssd1315_panel *panel, const unsigned char *data, unsigned int len)
+{
+  return SSD1315_Burst(panel, 0x40, data, len);
+}
+
+/* builds the window commands (horizontal addressing mode) in panel->win */
+static void SSD1315_WindowCmds( struct ssd1315_panel *panel, uint8_t startLine, uint8_t endLine, uint8_t startPos, uint8_t endPos )
+{
+  panel->win[0] = 0x00;                          // control byte: command stream
+  panel->win[1] = 0x21;                          // cmd for the column start and end address
+  panel->win[2] = startPos;                      // column start addr
+  panel->win[3] = endPos;                        // column end addr
+  panel->win[4] = 0x22;                          // cmd for the page start and end address
+  panel->win[5] = startLine;                     // page start addr
+  panel->win[6] = endLine;                       // page end addr
+}
+
+/* sets the RAM window the data bursts go to, as one command burst */
+static int SSD1315_SetWindow( struct ssd1315_panel *panel, uint8_t startLine, uint8_t endLine, uint8_t startPos, uint8_t endPos )
+{
+  SSD1315_WindowCmds(panel, startLine, endLine, startPos, endPos);
+
+  return SSD1315_WriteCmds(panel, &panel->win[1], sizeof(panel->win) - 1);
+}
+
+/*
+** true if the adapter takes two write messages chained with a repeated
+** START: no message count or length limit in the way, repeated START
+** supported, and no combined-message rule (write-then-read at most)
+*/
+static bool SSD1315_CanChain( struct ssd1315_panel *panel, unsigned int len )
+{
+  const struct i2c_adapter_quirks *quirks = panel->client->adapter->quirks;
+
+  if( panel->xfer != SSD1315_XFER_I2C )
+  {
+    return false;
+  }
+  if( !quirks )
+  {
+    return true;
+  }
+
+  return !( quirks->flags & ( I2C_AQ_NO_REP_START | I2C_AQ_COMB ) ) &&
+         ( !quirks->max_num_msgs  || ( quirks->max_num_msgs >= 2 ) ) &&
+         ( !quirks->max_write_len || ( quirks->max_write_len >= 1 + len ) );
+}
+
+/*
+** Sets the window and sends its data: the command message and the data
+** message are chained in one i2c_transfer(), so the adapter is locked once
+** and the data follows the window with a repeated START. Adapters whose
+** quirks don't allow that get the two bursts one after the other.
+*/
+static int SSD1315_WriteWindow(struct ssd1315_panel *panel, uint8_t startLine, uint8_t endLine,
+                                uint8_t startPos, uint8_t endPos, const unsigned char *data, unsigned int len )
+{
+  struct i2c_msg msgs[2];
+  int            ret;
+
+  if( !SSD1315_CanChain(panel, len) )
+  {
+    ret = SSD1315_SetWindow(panel, startLine, endLine, startPos, endPos);
+    if( ret < 0 )
+    {
+      return ret;
+    }
+    return SSD1315_WriteData(panel, data, len);
+  }
+
+  SSD1315_WindowCmds(panel, startLine, endLine, startPos, endPos);
+
+  panel->tx[0] = 0x40;                           // control byte: data stream
+  memcpy(&panel->tx[1], data, len);
+
+  msgs[0].addr  = panel->client->addr;
+  msgs[0].flags = 0;
+  msgs[0].len   = sizeof(panel->win);
+  msgs[0].buf   = panel->win;
+
+  msgs[1].addr  = panel->client->addr;
+  msgs[1].flags = 0;
+  msgs[1].len   = 1 + len;
+  msgs[1].buf   = panel->tx;
+
+  ret = i2c_transfer(panel->client->adapter, msgs, 2);
+
+  return ( ret < 0 ) ? ret : 0;
+}
+
+/* moves the drawing cursor in the shadow buffer, nothing is sent */
+static void SSD1315_SetCursor( struct ssd1315_panel *panel, uint8_t lineNo, uint8_t cursorPos )
 {
   /* Move the Cursor to specified position only if it is in range */
   if((lineNo <= SSD1315_MAX_LINE) && (cursorPos < SSD1315_MAX_SEG))
   {
-    SSD1315_LineNum   = lineNo;             // Save the specified line number
-    SSD1315_CursorPos = cursorPos;          // Save the specified cursor position
-    SSD1315_Write(true, 0x21);              // cmd for the column start and end address
-    SSD1315_Write(true, cursorPos);         // column start addr
-    SSD1315_Write(true, SSD1315_MAX_SEG-1); // column end addr
-    SSD1315_Write(true, 0x22);              // cmd for the page start and end address
-    SSD1315_Write(true, lineNo);            // page start addr
-    SSD1315_Write(true, SSD1315_MAX_LINE);  // page end addr
+    panel->line_num   = lineNo;             // Save the specified line number
+    panel->cursor_pos = cursorPos;          // Save the specified cursor position
   }
 }
 
-static void  SSD1315_GoToNextLine( void )
+static void  SSD1315_GoToNextLine( struct ssd1315_panel *panel )
 {
-  SSD1315_LineNum++;
-  SSD1315_LineNum = (SSD1315_LineNum & SSD1315_MAX_LINE);
+  panel->line_num++;
+  panel->line_num = (panel->line_num & SSD1315_MAX_LINE);
 
-  SSD1315_SetCursor(SSD1315_LineNum,0); /* Finally move it to next line */
+  SSD1315_SetCursor(panel, panel->line_num,0); /* Finally move it to next line */
 }
 
-static void SSD1315_PrintChar(unsigned char c)
+static void SSD1315_PrintChar(struct ssd1315_panel *panel, unsigned char c)
 {
   uint8_t data_byte;
   uint8_t temp = 0;
@@ -219,11 +394,11 @@ static void SSD1315_PrintChar(unsigned char c)
   ** If we character is greater than segment len or we got new line charcter
   ** then move the cursor to the new line
   */ 
-  if( (( SSD1315_CursorPos + SSD1315_FontSize ) >= SSD1315_MAX_SEG ) ||
+  if( (( panel->cursor_pos + panel->font_size ) >= SSD1315_MAX_SEG ) ||
       ( c == '\n' )
   )
   {
-    SSD1315_GoToNextLine();
+    SSD1315_GoToNextLine(panel);
   }
 
   // print charcters other than new line
@@ -231,7 +406,7 @@ static void SSD1315_PrintChar(unsigned char c)
   {
   
     /*
-    ** In our font array (SSD1315_font), space starts in 0th index.
+    ** In our font array (oled_font_5x7_glyphs), space starts in 0th index.
     ** But in ASCII table, Space starts from 32 (0x20).
     ** So we need to match the ASCII table with our font table.
     ** We can subtract 32 (0x20) in order to match with our font table.
@@ -240,162 +415,609 @@ static void SSD1315_PrintChar(unsigned char c)
 
     do
     {
-      data_byte= SSD1315_font[c][temp]; // Get the data to be displayed from LookUptable
+      data_byte= oled_fonts[OLED_FONT_5X7].glyphs[( c * SSD1315_DEF_FONT_SIZE ) + temp]; // Get the data to be displayed from LookUptable
 
-      SSD1315_Write(false, data_byte);  // write data to the OLED
-      SSD1315_CursorPos++;
+      panel->buffer[panel->line_num][panel->cursor_pos] = data_byte;  // render into the shadow buffer
+      panel->cursor_pos++;
       
       temp++;
       
-    } while ( temp < SSD1315_FontSize);
-    SSD1315_Write(false, 0x00);         //Display the data
-    SSD1315_CursorPos++;
+    } while ( temp < panel->font_size);
+    panel->buffer[panel->line_num][panel->cursor_pos] = 0x00;         // spacer column
+    panel->cursor_pos++;
+
+    panel->dirty_pages |= ( 1u << panel->line_num );
   }
 }
 
-static void SSD1315_String(unsigned char *str)
+static void SSD1315_String(struct ssd1315_panel *panel, unsigned char *str)
 {
   while(*str)
   {
-    SSD1315_PrintChar(*str++);
+    SSD1315_PrintChar(panel, *str++);
+  }
+}
+
+/*
+** Draws the string with one of the oled_fonts[] fonts (OLED_FONT_5X7,
+** OLED_FONT_8X16, OLED_FONT_12X24), in fixed cells or, if proportional,
+** in the inked columns of each glyph plus one. Each page of a glyph is a
+** straight copy; a new line moves down by the font height.
+*/
+static void SSD1315_StringFont(struct ssd1315_panel *panel, const char *str, unsigned int font_id, bool proportional)
+{
+  const struct oled_font *font;
+  const unsigned char    *glyph;
+  unsigned int            idx;
+  unsigned int            left;
+  unsigned int            width;
+  unsigned int            gap;
+  unsigned int            page;
+
+  if( font_id >= OLED_NR_FONTS )
+  {
+    return;
+  }
+  font = &oled_fonts[font_id];
+
+  for( ; *str; str++ )
+  {
+    idx   = (unsigned char)*str - font->first;
+    if( idx >= font->count )
+    {
+      idx = '?' - font->first;
+    }
+    left  = proportional ? font->left[idx] : 0;
+    width = proportional ? font->ink[idx]  : font->width;
+    gap   = proportional ? 1               : font->spacing;
+
+    //new line, or the glyph doesn't fit on the line
+    if( ( *str == '\n' ) || ( ( panel->cursor_pos + width ) > SSD1315_MAX_SEG ) )
+    {
+      panel->line_num  += font->pages;
+      panel->cursor_pos = 0;
+    }
+    //back to the top once the glyph rows don't fit, a trailing '\n' included
+    if( ( panel->line_num + font->pages ) > SSD1315_MAX_PAGE )
+    {
+      panel->line_num = 0;
+    }
+    if( *str == '\n' )
+    {
+      continue;
+    }
+
+    glyph = font->glyphs + ( idx * font->pages * font->width );
+
+    for( page = 0; page < font->pages; page++ )
+    {
+      memcpy(&panel->buffer[panel->line_num + page][panel->cursor_pos],
+             &glyph[( page * font->width ) + left], width);
+      memset(&panel->buffer[panel->line_num + page][panel->cursor_pos + width], 0x00,
+             min(gap, SSD1315_MAX_SEG - ( panel->cursor_pos + width )));
+    }
+
+    panel->dirty_pages |= ( ( 1u << font->pages ) - 1 ) << panel->line_num;
+    panel->cursor_pos   = min(panel->cursor_pos + width + gap, (unsigned int)SSD1315_MAX_SEG);
   }
 }
 
-static void SSD1315_InvertDisplay(bool need_to_invert)
+static void SSD1315_InvertDisplay(struct ssd1315_panel *panel, bool need_to_invert)
 {
   if(need_to_invert)
   {
-    SSD1315_Write(true, 0xA7); // Invert the display
+    SSD1315_Write(panel, true, 0xA7); // Invert the display
   }
   else
   {
-    SSD1315_Write(true, 0xA6); // Normal display
+    SSD1315_Write(panel, true, 0xA6); // Normal display
   }
 }
 
-static void SSD1315_SetBrightness(uint8_t brightnessValue)
+static void SSD1315_SetBrightness(struct ssd1315_panel *panel, uint8_t brightnessValue)
 {
-    SSD1315_Write(true, 0x81); // Contrast command
-    SSD1315_Write(true, brightnessValue); // Contrast value (default value = 0x7F)
+  unsigned char cmds[] =
+  {
+    0x81,                               // Contrast command
+    brightnessValue                     // Contrast value (default value = 0x7F)
+  };
+
+  SSD1315_WriteCmds(panel, cmds, sizeof(cmds));
 }
 
-static void SSD1315_StartScrollHorizontal( bool is_left_scroll,
+static void SSD1315_StartScrollHorizontal( struct ssd1315_panel *panel, bool is_left_scroll,
                                            uint8_t start_line_no,
                                            uint8_t end_line_no
                                          )
 {
-  if(is_left_scroll)
-  {
-    // left horizontal scroll
-    SSD1315_Write(true, 0x27);
-  }
-  else
+  unsigned char cmds[] =
   {
-    // right horizontal scroll 
-    SSD1315_Write(true, 0x26);
-  }
-  
-  SSD1315_Write(true, 0x00);            // Dummy byte (dont change)
-  SSD1315_Write(true, start_line_no);   // Start page address
-  SSD1315_Write(true, 0x00);            // 5 frames interval
-  SSD1315_Write(true, end_line_no);     // End page address
-  SSD1315_Write(true, 0x00);            // Dummy byte (dont change)
-  SSD1315_Write(true, 0xFF);            // Dummy byte (dont change)
-  SSD1315_Write(true, 0x2F);            // activate scroll
+    // left horizontal scroll or right horizontal scroll
+    is_left_scroll ? 0x27 : 0x26,
+    0x00,                               // Dummy byte (dont change)
+    start_line_no,                      // Start page address
+    0x00,                               // 5 frames interval
+    end_line_no,                        // End page address
+    0x00,                               // Dummy byte (dont change)
+    0xFF,                               // Dummy byte (dont change)
+    0x2F                                // activate scroll
+  };
+
+  SSD1315_WriteCmds(panel, cmds, sizeof(cmds));
 }
 
-static void SSD1315_StartScrollVerticalHorizontal( bool is_vertical_left_scroll,
+static void SSD1315_StartScrollVerticalHorizontal( struct ssd1315_panel *panel, bool is_vertical_left_scroll,
                                                    uint8_t start_line_no,
                                                    uint8_t end_line_no,
                                                    uint8_t vertical_area,
                                                    uint8_t rows
                                                  )
 {
-  
-  SSD1315_Write(true, 0xA3);            // Set Vertical Scroll Area
-  SSD1315_Write(true, 0x00);            // Check datasheet
-  SSD1315_Write(true, vertical_area);   // area for vertical scroll
-  
-  if(is_vertical_left_scroll)
+  unsigned char cmds[] =
+  {
+    0xA3,                               // Set Vertical Scroll Area
+    0x00,                               // Check datasheet
+    vertical_area,                      // area for vertical scroll
+    // vertical and left horizontal scroll or vertical and right horizontal scroll
+    is_vertical_left_scroll ? 0x2A : 0x29,
+    0x00,                               // Dummy byte (dont change)
+    start_line_no,                      // Start page address
+    0x00,                               // 5 frames interval
+    end_line_no,                        // End page address
+    rows,                               // Vertical scrolling offset
+    0x2F                                // activate scroll
+  };
+
+  SSD1315_WriteCmds(panel, cmds, sizeof(cmds));
+}
+
+
+/*
+** Commands to initialize the SSD_1306 OLED Display
+*/
+static const unsigned char SSD1315_InitCmds[] =
+{
+  0xAE, // Entire Display OFF
+  0xD5, // Set Display Clock Divide Ratio and Oscillator Frequency
+  0x80, // Default Setting for Display Clock Divide Ratio and Oscillator Frequency that is recommended
+  0xA8, // Set Multiplex Ratio
+  0x3F, // 64 COM lines
+  0xD3, // Set display offset
+  0x00, // 0 offset
+  0x40, // Set first line as the start line of the display
+  0x8D, // Charge pump
+  0x14, // Enable charge dump during display on
+  0x20, // Set memory addressing mode
+  0x00, // Horizontal addressing mode
+  0xA1, // Set segment remap with column address 127 mapped to segment 0
+  0xC8, // Set com output scan direction, scan from com63 to com 0
+  0xDA, // Set com pins hardware configuration
+  0x12, // Alternative com pin configuration, disable com left/right remap
+  0x81, // Set contrast control
+  0x80, // Set Contrast to 128
+  0xD9, // Set pre-charge period
+  0xF1, // Phase 1 period of 15 DCLK, Phase 2 period of 1 DCLK
+  0xDB, // Set Vcomh deselect level
+  0x20, // Vcomh deselect level ~ 0.77 Vcc
+  0xA4, // Entire display ON, resume to RAM content display
+  0xA6, // Set Display in Normal Mode, 1 = ON, 0 = OFF
+  0x2E, // Deactivate scroll
+  0xAF  // Display ON in normal mode
+};
+
+static int SSD1315_DisplayInit(struct ssd1315_panel *panel)
+{
+  msleep(100);               // delay
+
+  panel->hw_valid      = false;
+  panel->hw_start_line = 0;                                 // 0x40 in the init sequence
+
+  /* whole init sequence in one command burst */
+  SSD1315_WriteCmds(panel, SSD1315_InitCmds, sizeof(SSD1315_InitCmds));
+
+  //RAM content is unknown after power up: replay the whole shadow buffer,
+  //which already holds what was drawn before the first flush
+  panel->full_pages  = ( 1u << SSD1315_MAX_PAGE ) - 1;
+  panel->dirty_pages = ( 1u << SSD1315_MAX_PAGE ) - 1;
+  return 0;
+}
+
+static void SSD1315_Fill(struct ssd1315_panel *panel, unsigned char data)
+{
+  //Fill the Display: 8 pages x 128 segments x 8 bits of data
+  memset(panel->buffer, data, sizeof(panel->buffer));
+
+  panel->dirty_pages = ( 1u << SSD1315_MAX_PAGE ) - 1;
+}
+
+/* follows the controller pointer over len data bytes */
+static void SSD1315_Advance(struct ssd1315_panel *panel, unsigned int len)
+{
+  unsigned int width = panel->hw_col_end  - panel->hw_col_start  + 1;
+  unsigned int pages = panel->hw_page_end - panel->hw_page_start + 1;
+  unsigned int pos;
+
+  pos = ( ( panel->hw_page - panel->hw_page_start ) * width ) + ( panel->hw_col - panel->hw_col_start );
+  pos = ( pos + len ) % ( width * pages );
+
+  panel->hw_page = panel->hw_page_start + ( pos / width );
+  panel->hw_col  = panel->hw_col_start  + ( pos % width );
+}
+
+/* true if the frame bytes [first, last] land in place from the current pointer */
+static bool SSD1315_RunLands(struct ssd1315_panel *panel, unsigned int first, unsigned int last)
+{
+  if( !panel->hw_valid ||
+      ( panel->hw_page != first / SSD1315_MAX_SEG ) || ( panel->hw_col != first % SSD1315_MAX_SEG ) )
+  {
+    return false;
+  }
+
+  //full width window: the run may go on in the next pages
+  if( ( panel->hw_col_start == 0 ) && ( panel->hw_col_end == SSD1315_MAX_SEG - 1 ) )
   {
-    // vertical and left horizontal scroll
-    SSD1315_Write(true, 0x2A);
+    return ( last / SSD1315_MAX_SEG ) <= panel->hw_page_end;
+  }
+
+  return ( ( last / SSD1315_MAX_SEG ) == panel->hw_page ) && ( ( last % SSD1315_MAX_SEG ) <= panel->hw_col_end );
+}
+
+/*
+** Sends the frame bytes [first, last] (offsets in panel->buffer) and
+** returns the bytes it cost. Without the pointer on first, a run starting
+** a page gets a full width window down to the last page, so the next runs
+** can follow on; a run inside one page gets a window on its own columns.
+** Runs starting mid-page and crossing pages are split by the caller.
+*/
+static unsigned int SSD1315_SendRun(struct ssd1315_panel *panel, unsigned int first, unsigned int last)
+{
+  const uint8_t *frame = &panel->buffer[0][0];
+  unsigned int   len   = last - first + 1;
+  uint8_t        page  = first / SSD1315_MAX_SEG;
+  uint8_t        col   = first % SSD1315_MAX_SEG;
+  unsigned int   cost  = len;
+  int            ret;
+
+  if( SSD1315_RunLands(panel, first, last) )
+  {
+    ret = SSD1315_WriteData(panel, &frame[first], len);
   }
   else
   {
-    // vertical and right horizontal scroll 
-    SSD1315_Write(true, 0x29);
+    panel->hw_page_start = page;
+    panel->hw_page_end   = ( col == 0 ) ? ( SSD1315_MAX_PAGE - 1 ) : page;
+    panel->hw_col_start  = col;
+    panel->hw_col_end    = SSD1315_MAX_SEG - 1;
+    panel->hw_page       = page;
+    panel->hw_col        = col;
+
+    ret = SSD1315_WriteWindow(panel, panel->hw_page_start, panel->hw_page_end,
+                              panel->hw_col_start, panel->hw_col_end, &frame[first], len);
+    cost += 6;
   }
-  
-  SSD1315_Write(true, 0x00);            // Dummy byte (dont change)
-  SSD1315_Write(true, start_line_no);   // Start page address
-  SSD1315_Write(true, 0x00);            // 5 frames interval
-  SSD1315_Write(true, end_line_no);     // End page address
-  SSD1315_Write(true, rows);            // Vertical scrolling offset
-  SSD1315_Write(true, 0x2F);            // activate scroll
+
+  panel->hw_valid = ( ret >= 0 );
+  if( panel->hw_valid )
+  {
+    SSD1315_Advance(panel, len);
+  }
+
+  return cost;
 }
 
+/* page of offset i is flushed and its byte differs from the panel RAM */
+static bool SSD1315_Changed(struct ssd1315_panel *panel, unsigned int i)
+{
+  const uint8_t bit = 1u << ( i / SSD1315_MAX_SEG );
+
+  if( !( panel->dirty_pages & bit ) )
+  {
+    return false;
+  }
+  if( panel->full_pages & bit )
+  {
+    return true;
+  }
+  return ( &panel->buffer[0][0] )[i] != ( &panel->sent[0][0] )[i];
+}
 
-static int SSD1315_DisplayInit(void)
+/*
+** Sends the changes of the dirty pages of the shadow buffer. The frame is
+** walked in the order the controller pointer moves in horizontal mode, so
+** changes on consecutive pages join into one run when the gap is cheaper
+** than a new window: a full redraw is one window and one data burst.
+** The pages of a failed run stay dirty and are sent whole next time.
+*/
+static void SSD1315_Flush(struct ssd1315_panel *panel)
 {
-  msleep(100);               // delay
-  /*
-  ** Commands to initialize the SSD_1306 OLED Display
-  */
-  SSD1315_Write(true, 0xAE); // Entire Display OFF
-  SSD1315_Write(true, 0xD5); // Set Display Clock Divide Ratio and Oscillator Frequency
-  SSD1315_Write(true, 0x80); // Default Setting for Display Clock Divide Ratio and Oscillator Frequency that is recommended
-  SSD1315_Write(true, 0xA8); // Set Multiplex Ratio
-  SSD1315_Write(true, 0x3F); // 64 COM lines
-  SSD1315_Write(true, 0xD3); // Set display offset
-  SSD1315_Write(true, 0x00); // 0 offset
-  SSD1315_Write(true, 0x40); // Set first line as the start line of the display
-  SSD1315_Write(true, 0x8D); // Charge pump
-  SSD1315_Write(true, 0x14); // Enable charge dump during display on
-  SSD1315_Write(true, 0x20); // Set memory addressing mode
-  SSD1315_Write(true, 0x00); // Horizontal addressing mode
-  SSD1315_Write(true, 0xA1); // Set segment remap with column address 127 mapped to segment 0
-  SSD1315_Write(true, 0xC8); // Set com output scan direction, scan from com63 to com 0
-  SSD1315_Write(true, 0xDA); // Set com pins hardware configuration
-  SSD1315_Write(true, 0x12); // Alternative com pin configuration, disable com left/right remap
-  SSD1315_Write(true, 0x81); // Set contrast control
-  SSD1315_Write(true, 0x80); // Set Contrast to 128
-  SSD1315_Write(true, 0xD9); // Set pre-charge period
-  SSD1315_Write(true, 0xF1); // Phase 1 period of 15 DCLK, Phase 2 period of 1 DCLK
-  SSD1315_Write(true, 0xDB); // Set Vcomh deselect level
-  SSD1315_Write(true, 0x20); // Vcomh deselect level ~ 0.77 Vcc
-  SSD1315_Write(true, 0xA4); // Entire display ON, resume to RAM content display
-  SSD1315_Write(true, 0xA6); // Set Display in Normal Mode, 1 = ON, 0 = OFF
-  SSD1315_Write(true, 0x2E); // Deactivate scroll
-  SSD1315_Write(true, 0xAF); // Display ON in normal mode
-  
-  //Clear the display
-  SSD1315_Fill(0x00);
+  unsigned int i = 0;
+  unsigned int first;
+  unsigned int last;
+  unsigned int split;
+  unsigned int sent_bytes = 0;
+  uint8_t      lost       = 0;
+  uint8_t      page;
+  unsigned int whole      = hweight8(panel->dirty_pages) * ( 6 + SSD1315_MAX_SEG );
+
+  while( i < SSD1315_FRAME_SIZE )
+  {
+    if( !SSD1315_Changed(panel, i) )
+    {
+      i++;
+      continue;
+    }
+
+    //run ends at the last change before a gap worth a new window
+    first = i;
+    last  = i;
+
+    for( i = last + 1; i < SSD1315_FRAME_SIZE; i++ )
+    {
+      if( SSD1315_Changed(panel, i) )
+      {
+        last = i;
+      }
+      else if( ( i - last ) > SSD1315_WINDOW_COST )
+      {
+        break;
+      }
+    }
+    i = last + 1;
+
+    if( !SSD1315_RunLands(panel, first, last) && ( first % SSD1315_MAX_SEG ) )
+    {
+      //a few columns from the page start are cheaper than a second window
+      if( ( first % SSD1315_MAX_SEG ) <= SSD1315_WINDOW_COST )
+      {
+        first -= first % SSD1315_MAX_SEG;
+      }
+      else if( ( last / SSD1315_MAX_SEG ) != ( first / SSD1315_MAX_SEG ) )
+      {
+        split       = first - ( first % SSD1315_MAX_SEG ) + SSD1315_MAX_SEG;
+        sent_bytes += SSD1315_SendRun(panel, first, split - 1);
+        if( !panel->hw_valid )
+        {
+          lost |= GENMASK(( split - 1 ) / SSD1315_MAX_SEG, first / SSD1315_MAX_SEG);
+        }
+        first       = split;
+      }
+    }
+
+    sent_bytes += SSD1315_SendRun(panel, first, last);
+    if( !panel->hw_valid )
+    {
+      lost |= GENMASK(last / SSD1315_MAX_SEG, first / SSD1315_MAX_SEG);
+    }
+  }
+
+  if( whole > sent_bytes )
+  {
+    panel->delta_saved += whole - sent_bytes;
+  }
+
+  for( page = 0; page < SSD1315_MAX_PAGE; page++ )
+  {
+    if( !( lost & ( 1u << page ) ) )
+    {
+      memcpy(panel->sent[page], panel->buffer[page], SSD1315_MAX_SEG);
+    }
+  }
+  panel->full_pages   = ( panel->full_pages & ~panel->dirty_pages ) | lost;
+  panel->dirty_pages  = lost;
+}
+
+/* sysfs: /sys/bus/i2c/devices/<bus>-003c/delta_saved */
+static ssize_t delta_saved_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+  struct ssd1315_panel *panel = dev_get_drvdata(dev);
+
+  return sprintf(buf, "%lu\n", panel->delta_saved);
+}
+static DEVICE_ATTR_RO(delta_saved);
+
+/* sysfs: /sys/bus/i2c/devices/<bus>-003c/transport */
+static ssize_t transport_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+  struct ssd1315_panel *panel = dev_get_drvdata(dev);
+
+  return sprintf(buf, "%s\n", SSD1315_XferNames[panel->xfer]);
+}
+static DEVICE_ATTR_RO(transport);
+
+/* picks the fastest transport the adapter can do */
+static int SSD1315_SelectXfer(struct ssd1315_panel *panel)
+{
+  const struct i2c_adapter_quirks *quirks = panel->client->adapter->quirks;
+  u32                              func   = i2c_get_functionality(panel->client->adapter);
+
+  //raw writes need room for the control byte and at least one data byte
+  if( ( func & I2C_FUNC_I2C ) &&
+      ( !quirks || !quirks->max_write_len || ( quirks->max_write_len >= 2 ) ) )
+  {
+    panel->xfer = SSD1315_XFER_I2C;
+  }
+  else if( func & I2C_FUNC_SMBUS_WRITE_I2C_BLOCK )
+  {
+    panel->xfer = SSD1315_XFER_SMBUS_BLOCK;
+  }
+  else if( func & I2C_FUNC_SMBUS_WRITE_BYTE_DATA )
+  {
+    panel->xfer = SSD1315_XFER_SMBUS_BYTE;
+  }
+  else
+  {
+    return -EOPNOTSUPP;
+  }
+
   return 0;
 }
 
-static void SSD1315_Fill(unsigned char data)
+/* starts a console line: the next free page, or the top one scrolled to the bottom */
+static void SSD1315_ConsoleNewLine(struct ssd1315_panel *panel)
 {
-  unsigned int total  = 128 * 8;  // 8 pages x 128 segments x 8 bits of data
-  unsigned int i      = 0;
-  
-  //Fill the Display
-  for(i = 0; i < total; i++)
+  uint8_t page;
+
+  if( panel->con_rows < SSD1315_MAX_PAGE )
+  {
+    page = ( panel->con_top + panel->con_rows ) % SSD1315_MAX_PAGE;
+    panel->con_rows++;
+  }
+  else
+  {
+    page              = panel->con_top;
+    panel->con_top    = ( panel->con_top + 1 ) % SSD1315_MAX_PAGE;
+    panel->start_line = panel->con_top * 8;
+  }
+
+  memset(panel->buffer[page], 0x00, SSD1315_MAX_SEG);
+  panel->dirty_pages |= ( 1u << page );
+  SSD1315_SetCursor(panel, page, 0);
+}
+
+/* console output: '\n' ends a line, long lines wrap, '\f' clears the screen */
+static void SSD1315_ConsoleWrite(struct ssd1315_panel *panel, const char *str, size_t len)
+{
+  size_t i;
+
+  for( i = 0; i < len; i++ )
+  {
+    if( str[i] == '\f' )
+    {
+      SSD1315_Fill(panel, 0x00);
+      panel->con_top     = 0;
+      panel->con_rows    = 0;
+      panel->con_newline = true;
+      panel->start_line  = 0;
+    }
+    else if( str[i] == '\n' )
+    {
+      panel->con_newline = true;
+    }
+    else if( ( str[i] >= 0x20 ) && ( str[i] < 0x7f ) )
+    {
+      if( panel->con_newline || !panel->con_rows ||
+          ( ( panel->cursor_pos + panel->font_size ) >= SSD1315_MAX_SEG ) )
+      {
+        SSD1315_ConsoleNewLine(panel);
+        panel->con_newline = false;
+      }
+      SSD1315_PrintChar(panel, str[i]);
+    }
+  }
+}
+
+/* worker: brings the panel up on first use, then sends the shadow buffer */
+static void SSD1315_FlushWork(struct work_struct *work)
+{
+  struct ssd1315_panel *panel = container_of(work, struct ssd1315_panel, flush_work);
+
+  mutex_lock(&panel->lock);
+
+  if( !panel->ready )
+  {
+    SSD1315_DisplayInit(panel);
+    panel->ready = true;
+  }
+  SSD1315_Flush(panel);
+
+  //scroll once the new line is in RAM
+  if( panel->start_line != panel->hw_start_line )
+  {
+    SSD1315_Write(panel, true, 0x40 | panel->start_line);
+    panel->hw_start_line = panel->start_line;
+  }
+
+  mutex_unlock(&panel->lock);
+}
+
+/* queues a flush on the panel worker; flushes queued meanwhile merge */
+static void SSD1315_Kick(struct ssd1315_panel *panel)
+{
+  queue_work(panel->wq, &panel->flush_work);
+}
+
+static void SSD1315_DestroyWq(void *wq)
+{
+  destroy_workqueue(wq);
+}
+
+/* sysfs: /sys/bus/i2c/devices/<bus>-003c/console, text appended to the console */
+static ssize_t console_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+  struct ssd1315_panel *panel = dev_get_drvdata(dev);
+
+  mutex_lock(&panel->lock);
+  SSD1315_ConsoleWrite(panel, buf, count);
+  mutex_unlock(&panel->lock);
+
+  SSD1315_Kick(panel);
+
+  return count;
+}
+static DEVICE_ATTR_WO(console);
+
+/*
+** sysfs: /sys/bus/i2c/devices/<bus>-003c/text
+** "<font>[,prop] <page> <col> <text>", font one of the oled_fonts[] names:
+** draws the rest of the line at RAM page/column, '\n' moves down a line
+*/
+static ssize_t text_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+  struct ssd1315_panel *panel = dev_get_drvdata(dev);
+  char                  name[24];
+  char                 *mode;
+  unsigned int          page;
+  unsigned int          col;
+  unsigned int          id;
+  int                   n = 0;
+
+  if( ( sscanf(buf, "%23s %u %u %n", name, &page, &col, &n) < 3 ) || ( n == 0 ) ||
+      ( page >= SSD1315_MAX_PAGE ) || ( col >= SSD1315_MAX_SEG ) )
+  {
+    return -EINVAL;
+  }
+
+  mode = strchr(name, ',');
+  if( mode )
+  {
+    *mode++ = '\0';
+    if( strcmp(mode, "prop") )
+    {
+      return -EINVAL;
+    }
+  }
+  for( id = 0; id < OLED_NR_FONTS; id++ )
+  {
+    if( strcmp(name, oled_fonts[id].name) == 0 )
+    {
+      break;
+    }
+  }
+  if( id == OLED_NR_FONTS )
   {
-      SSD1315_Write(false, data);
+    return -EINVAL;
   }
+
+  mutex_lock(&panel->lock);
+  SSD1315_SetCursor(panel, page, col);
+  SSD1315_StringFont(panel, buf + n, id, mode != NULL);
+  mutex_unlock(&panel->lock);
+
+  SSD1315_Kick(panel);
+
+  return count;
 }
+static DEVICE_ATTR_WO(text);
 
 /******************************************************************************************************/
 /******************************************************************************************************/
 
-#if 0
-/* for <driver_name>_dt_ids */
-static const struct of_device_id <driver_name>_dt_ids[] = {
-    { .compatible = "<vendor>, <device_name>", },
+/* for oled_i2c_dt_ids (ACPI matches it too, through PRP0001) */
+static const struct of_device_id oled_i2c_dt_ids[] = {
+    { .compatible = "solomon,ssd1315", },
     {}    
 };
-#endif
+MODULE_DEVICE_TABLE(of, oled_i2c_dt_ids);
 
 /* for oled_i2c_idtable */
 static struct i2c_device_id oled_i2c_idtable[] = 
@@ -408,23 +1030,70 @@ MODULE_DEVICE_TABLE(i2c, oled_i2c_idtable);
 /* for oled_i2c_probe func */
 static int oled_i2c_probe(struct i2c_client* client, const struct i2c_device_id *id)
 {
-    pr_info("\n going to probe. ");
+    struct ssd1315_panel *panel;
+    int ret;
+
+    pr_info("\n going to probe %d-%04x. ", i2c_adapter_id(client->adapter), client->addr);
     /* perform initialization tasks for OLED display module*/
 
-    if( strcmp(client->dev.driver->name, OLED_I2C_NAME) == 0)
+    if( ( client->addr != oled_i2c_addrs[0] ) && ( client->addr != oled_i2c_addrs[1] ) )
+    {
+        pr_err("\n 0x%02x is not an SSD1315 address. ", client->addr);
+        return -ENODEV;
+    }
+
+    panel = devm_kzalloc(&client->dev, sizeof(*panel), GFP_KERNEL);
+    if( !panel )
+    {
+        return -ENOMEM;
+    }
+
+    /* save the client handle for later use*/
+    panel->client     = client;
+    panel->font_size  = SSD1315_DEF_FONT_SIZE;
+    panel->full_pages = ( 1u << SSD1315_MAX_PAGE ) - 1;
+    panel->con_newline = true;
+    mutex_init(&panel->lock);
+    INIT_WORK(&panel->flush_work, SSD1315_FlushWork);
+    i2c_set_clientdata(client, panel);
+
+    if( SSD1315_SelectXfer(panel) < 0 )
     {
-        /* save the client handle for later use*/
-        oled_client = client;
+        pr_err("\n adapter can't write to 0x%02x. ", client->addr);
+        return -ENODEV;
+    }
+    pr_info("\n 0x%02x uses %s transfers. ", client->addr, SSD1315_XferNames[panel->xfer]);
+
+    panel->wq = alloc_ordered_workqueue("ssd1315-%s", 0, dev_name(&client->dev));
+    if( !panel->wq )
+    {
+        return -ENOMEM;
+    }
+    ret = devm_add_action_or_reset(&client->dev, SSD1315_DestroyWq, panel->wq);
+    if( ret )
+    {
+        return ret;
+    }
+
+    mutex_lock(&panel->lock);
+
+    /* set ...*/
+    SSD1315_SetCursor(panel, 0,0);  
 
-        /* init  */
-        SSD1315_DisplayInit();
-        
-        /* set ...*/
-        SSD1315_SetCursor(0,0);  
+    /* Display "Hallo world" to OLED */
+    SSD1315_String(panel, "Hallo world\n");
 
-        /* Display "Hallo world" to OLED */
-        SSD1315_String("Hallo world\n");
+    mutex_unlock(&panel->lock);
 
+    /* init + send the shadow buffer, on the panel worker */
+    SSD1315_Kick(panel);
+
+    if( device_create_file(&client->dev, &dev_attr_delta_saved) ||
+        device_create_file(&client->dev, &dev_attr_transport) ||
+        device_create_file(&client->dev, &dev_attr_console) ||
+        device_create_file(&client->dev, &dev_attr_text) )
+    {
+        pr_err("\n Cannot create sysfs file. ");
     }
 
     pr_info("\n probeded successfully. ");
@@ -436,19 +1105,34 @@ static int oled_i2c_probe(struct i2c_client* client, const struct i2c_device_id
 /* for oled_i2c_remove func */
 static int oled_i2c_remove(struct i2c_client* client)
 {
-    pr_info("\n going to remove. ");
+    struct ssd1315_panel *panel = i2c_get_clientdata(client);
+
+    pr_info("\n going to remove 0x%02x. ", client->addr);
     /* perform clean up for OLED display module */
 
     //fill the OLED with this data
     msleep(1000);
     
+    device_remove_file(&client->dev, &dev_attr_delta_saved);
+    device_remove_file(&client->dev, &dev_attr_transport);
+    device_remove_file(&client->dev, &dev_attr_console);
+    device_remove_file(&client->dev, &dev_attr_text);
+
+    /* let the queued flushes finish, the worker is destroyed after remove */
+    flush_workqueue(panel->wq);
+
+    mutex_lock(&panel->lock);
+
     //Set cursor
-    SSD1315_SetCursor(0,0);  
+    SSD1315_SetCursor(panel, 0,0);  
 
     //clear the display
-    SSD1315_Fill(0x00);
+    SSD1315_Fill(panel, 0x00);
+    SSD1315_Flush(panel);
     
-    SSD1315_Write(true, 0xAE); // Entire Display OFF
+    SSD1315_Write(panel, true, 0xAE); // Entire Display OFF
+
+    mutex_unlock(&panel->lock);
 
     pr_info("\n removed successfully. ");
 
@@ -467,7 +1151,8 @@ static struct i2c_driver oled_i2c_driver =
     .driver = {
         .name  = OLED_I2C_NAME,
         .owner = THIS_MODULE,
-        //.of_match_table = of_match_ptr(<driver_name>_dt_ids),
+        .probe_type = PROBE_PREFER_ASYNCHRONOUS,
+        .of_match_table = oled_i2c_dt_ids,
     }
 };
 
@@ -477,49 +1162,72 @@ static int __init oled_i2c_driver_init(void)
     pr_info("\n@frk: going to init...");
     // ...
     int ret;
+    int i;
     struct i2c_adapter* adapter;
+    struct i2c_board_info info = oled_info;
 
-    /* get I2C adapter corresponding to the desired bus number */
-    adapter = i2c_get_adapter(OLED_I2C_BUS_AVAILABLE);
-    if( !adapter ){
-        pr_err("\n@frk: FAILED to get I2C adapter. ");
-        return -ENODEV;
-    }
+    for( i = 0; i < frk_i2c_nr_panels; i++ )
+    {
+        /* get I2C adapter corresponding to the desired bus number */
+        adapter = i2c_get_adapter(frk_i2c_bus[i]);
+        if( !adapter ){
+            pr_err("\n@frk: FAILED to get I2C adapter %d. ", frk_i2c_bus[i]);
+            ret = -ENODEV;
+            goto r_clients;
+        }
 
-    /* create I2c device using adapter & board*/
-    oled_client = i2c_new_client_device(adapter, &oled_info);
-    if ( !oled_client){
-        pr_err("\n FAILED to create I2C device.");
+        /* create I2c device using adapter & board*/
+        info.addr = frk_i2c_addr[i];
+        if( info.addr )
+        {
+            oled_clients[i] = i2c_new_client_device(adapter, &info);
+        }
+        else
+        {
+            oled_clients[i] = i2c_new_scanned_device(adapter, &info, oled_i2c_addrs, NULL);
+        }
         i2c_put_adapter(adapter);
-        return -ENODEV;
+        if ( IS_ERR(oled_clients[i]) ){
+            pr_err("\n FAILED to create I2C device 0x%02x on bus %d.", info.addr, frk_i2c_bus[i]);
+            ret = PTR_ERR(oled_clients[i]);
+            goto r_clients;
+        }
     }
 
-    /* register the driver with the kernel */
+    /* register the driver with the kernel: probes every panel */
     ret = i2c_add_driver(&oled_i2c_driver);
     if (ret<0){
         pr_err("\n Error to register OLED-I2C driver. ");
-        i2c_unregister_device(oled_client);
-        i2c_put_adapter(adapter);
-        return ret;
+        goto r_clients;
     }
 
-    i2c_put_adapter(adapter);
-
     /* return success */
     pr_info("\n @frk: I2C-oled insert ... DONE!!! \n");
     return 0;
+
+r_clients:
+    while( i-- > 0 )
+    {
+        i2c_unregister_device(oled_clients[i]);
+    }
+    return ret;
 }
 
 /* module exit func*/
 static void __exit oled_i2c_driver_exit(void)
 {
+    int i;
+
     pr_info("\n@FRK: going to remove...");
     
     /* unregister the driver from kernel */ 
     i2c_del_driver(&oled_i2c_driver);
 
-    /* unregister the device from kernel*/
-    i2c_unregister_device(oled_client);
+    /* unregister the devices from kernel*/
+    for( i = frk_i2c_nr_panels - 1; i >= 0; i-- )
+    {
+        i2c_unregister_device(oled_clients[i]);
+    }
 
     /* return success */
     pr_info("\n @frk: I2C-oled remove ... DONE!!! \n");
@@ -0,0 +1,579 @@
+/***************************************************************************************************//**
+*  \file       oled_i2c_emu.c
+*
+*  \details    Virtual I2C adapter with an emulated SSD1315 behind it (benchmarking without a panel)
+*
+*  \author     Frank
+*
+*  \board      Linux raspberrypi 5.15.91-v8+
+*
+*  Load it before oled_i2c_driver.ko: the module registers an adapter,
+*  creates the "oled_ssd1315" client on it and the driver probes that
+*  client like a real panel. Every message is decoded as the SSD1315
+*  does it (control bytes, command set, addressing modes) into a 128x64
+*  GDDRAM image, and the bus time is accounted at emu_clock_hz.
+*
+*  /sys/kernel/debug/oled_i2c_emu/fb     GDDRAM image, 8 pages x 128 bytes
+*  /sys/kernel/debug/oled_i2c_emu/stats  transactions, bytes, bus time, state
+*  /sys/kernel/debug/oled_i2c_emu/reset  write anything to zero the counters
+*
+******************************************************************************************************/
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/device.h>
+#include <linux/delay.h>
+#include <linux/err.h>
+#include <linux/i2c.h>
+#include <linux/mutex.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/math64.h>
+
+/* print */
+#undef pr_fmt
+#define pr_fmt(fmt) "@frk-i2c_emu: [%s] :" fmt,__func__
+
+#define OLED_EMU_PANEL_NAME     "oled_ssd1315"              // name the OLED driver binds to
+#define OLED_EMU_MAX_SEG        ( 128 )
+#define OLED_EMU_MAX_PAGE       (   8 )
+
+static unsigned short emu_addr = 0x3c;
+module_param(emu_addr, ushort, 0444);
+MODULE_PARM_DESC(emu_addr, "I2C address of the emulated panel (default 0x3c)");
+
+static unsigned int emu_clock_hz = 400000;
+module_param(emu_clock_hz, uint, 0644);
+MODULE_PARM_DESC(emu_clock_hz, "Simulated SCL clock in Hz (default 400000)");
+
+static bool emu_realtime;
+module_param(emu_realtime, bool, 0644);
+MODULE_PARM_DESC(emu_realtime, "Sleep for the simulated bus time of each transfer (default off)");
+
+static bool emu_smbus_only;
+module_param(emu_smbus_only, bool, 0444);
+MODULE_PARM_DESC(emu_smbus_only, "Emulate an SMBus-only adapter (default off)");
+
+static bool emu_create_client = true;
+module_param(emu_create_client, bool, 0444);
+MODULE_PARM_DESC(emu_create_client, "Create the " OLED_EMU_PANEL_NAME " client on the adapter (default on)");
+
+/*
+** Controller state, as far as it changes what the GDDRAM receives. The
+** scroll setup is only recorded: the SSD1315 scrolls the display output,
+** the RAM content stays where it was written.
+*/
+struct oled_emu_state
+{
+  uint8_t   ram[OLED_EMU_MAX_PAGE][OLED_EMU_MAX_SEG];
+
+  uint8_t   mode;                                   // 0x20: 0 horizontal, 1 vertical, 2 page
+  uint8_t   col_start, col_end;                     // 0x21 window
+  uint8_t   page_start, page_end;                   // 0x22 window
+  uint8_t   col, page;                              // RAM pointer
+
+  uint8_t   cmd[8];                                 // command being collected
+  uint8_t   cmd_len;
+  uint8_t   cmd_need;                               // bytes of the whole command
+
+  bool      display_on;
+  bool      inverted;
+  uint8_t   contrast;
+  uint8_t   start_line;
+  bool      scroll_active;
+  uint8_t   scroll_cmd;                             // last scroll setup: 0x26/0x27/0x29/0x2A
+  uint8_t   scroll_start, scroll_end;               // pages
+
+  /* statistics */
+  u64       xfers;                                  // i2c_transfer()/smbus calls
+  u64       msgs;                                   // messages (start conditions)
+  u64       bytes;                                  // bytes on the bus, address byte included
+  u64       data_bytes;                             // GDDRAM bytes written
+  u64       cmd_bytes;                              // command bytes decoded
+  u64       bus_ns;                                 // simulated bus time
+  u64       frames;                                 // writes that wrapped past the last window byte
+  u64       nacks;                                  // messages to another address or reads
+};
+
+static struct oled_emu_state emu;
+static DEFINE_MUTEX(emu_lock);
+
+static struct dentry *emu_debugfs;
+static struct i2c_client *emu_client;
+
+/******************************************************************************************************/
+/* SSD1315 decoder */
+
+/* bytes of a command, opcode included */
+static uint8_t OledEmu_CmdLength(uint8_t op)
+{
+  switch( op )
+  {
+    case 0x20: case 0x81: case 0x8D: case 0xA8: case 0xAD:
+    case 0xD3: case 0xD5: case 0xD9: case 0xDA: case 0xDB:
+      return 2;
+
+    case 0x21: case 0x22: case 0xA3:
+      return 3;
+
+    case 0x29: case 0x2A:
+      return 6;
+
+    case 0x26: case 0x27: case 0x2C: case 0x2D:
+      return 7;
+
+    default:
+      return 1;
+  }
+}
+
+static void OledEmu_Command(struct oled_emu_state *s)
+{
+  uint8_t *c = s->cmd;
+
+  switch( c[0] )
+  {
+    case 0x20:
+      s->mode = c[1] & 0x03;
+      break;
+
+    case 0x21:
+      s->col_start = c[1] & 0x7F;
+      s->col_end   = c[2] & 0x7F;
+      s->col       = s->col_start;
+      break;
+
+    case 0x22:
+      s->page_start = c[1] & 0x07;
+      s->page_end   = c[2] & 0x07;
+      s->page       = s->page_start;
+      break;
+
+    case 0x81:
+      s->contrast = c[1];
+      break;
+
+    case 0x26: case 0x27:
+      s->scroll_cmd   = c[0];
+      s->scroll_start = c[2] & 0x07;
+      s->scroll_end   = c[4] & 0x07;
+      break;
+
+    case 0x29: case 0x2A:
+      s->scroll_cmd   = c[0];
+      s->scroll_start = c[2] & 0x07;
+      s->scroll_end   = c[4] & 0x07;
+      break;
+
+    case 0x2E: s->scroll_active = false; break;
+    case 0x2F: s->scroll_active = true;  break;
+    case 0xA6: s->inverted      = false; break;
+    case 0xA7: s->inverted      = true;  break;
+    case 0xAE: s->display_on    = false; break;
+    case 0xAF: s->display_on    = true;  break;
+
+    default:
+      if( ( c[0] >= 0xB0 ) && ( c[0] <= 0xB7 ) )             // page start (page mode)
+      {
+        s->page = c[0] & 0x07;
+      }
+      else if( c[0] <= 0x0F )                                 // lower column nibble (page mode)
+      {
+        s->col = ( s->col & 0xF0 ) | c[0];
+      }
+      else if( ( c[0] >= 0x10 ) && ( c[0] <= 0x1F ) )         // upper column nibble (page mode)
+      {
+        s->col = ( s->col & 0x0F ) | ( ( c[0] & 0x0F ) << 4 );
+      }
+      else if( ( c[0] >= 0x40 ) && ( c[0] <= 0x7F ) )         // display start line
+      {
+        s->start_line = c[0] & 0x3F;
+      }
+      break;
+  }
+}
+
+static void OledEmu_CmdByte(struct oled_emu_state *s, uint8_t b)
+{
+  s->cmd_bytes++;
+
+  if( s->cmd_len == 0 )
+  {
+    s->cmd_need = OledEmu_CmdLength(b);
+  }
+  s->cmd[s->cmd_len++] = b;
+
+  if( s->cmd_len == s->cmd_need )
+  {
+    OledEmu_Command(s);
+    s->cmd_len = 0;
+  }
+}
+
+/* one GDDRAM byte, then the pointer moves as the addressing mode says */
+static void OledEmu_DataByte(struct oled_emu_state *s, uint8_t b)
+{
+  s->data_bytes++;
+  s->ram[s->page & 0x07][s->col & 0x7F] = b;
+
+  switch( s->mode )
+  {
+    case 0:                                                   // horizontal
+      if( s->col++ >= s->col_end )
+      {
+        s->col = s->col_start;
+        if( s->page++ >= s->page_end )
+        {
+          s->page = s->page_start;
+          s->frames++;
+        }
+      }
+      break;
+
+    case 1:                                                   // vertical
+      if( s->page++ >= s->page_end )
+      {
+        s->page = s->page_start;
+        if( s->col++ >= s->col_end )
+        {
+          s->col = s->col_start;
+          s->frames++;
+        }
+      }
+      break;
+
+    default:                                                  // page: wraps in the page
+      s->col = ( s->col + 1 ) & 0x7F;
+      break;
+  }
+}
+
+/*
+** One write message after the address byte: control byte (Co, D/C#),
+** then a single byte and another control byte while Co is set, or the
+** rest of the message when Co is clear.
+*/
+static void OledEmu_Message(struct oled_emu_state *s, const uint8_t *buf, unsigned int len)
+{
+  unsigned int i = 0;
+  uint8_t      ctrl;
+
+  while( i < len )
+  {
+    ctrl = buf[i++];
+
+    if( ctrl & 0x80 )
+    {
+      if( i < len )
+      {
+        if( ctrl & 0x40 ) OledEmu_DataByte(s, buf[i]); else OledEmu_CmdByte(s, buf[i]);
+        i++;
+      }
+      continue;
+    }
+
+    for( ; i < len; i++ )
+    {
+      if( ctrl & 0x40 ) OledEmu_DataByte(s, buf[i]); else OledEmu_CmdByte(s, buf[i]);
+    }
+  }
+}
+
+/* start + address byte + len bytes, 9 clocks a byte, + stop */
+static void OledEmu_Account(struct oled_emu_state *s, unsigned int len)
+{
+  u64 bits = ( ( 1ull + len ) * 9 ) + 2;
+
+  s->msgs++;
+  s->bytes  += 1 + len;
+  s->bus_ns += div_u64(bits * NSEC_PER_SEC, emu_clock_hz ? emu_clock_hz : 1);
+}
+
+static void OledEmu_Sleep(u64 ns)
+{
+  if( emu_realtime && ( ns >= NSEC_PER_USEC ) )
+  {
+    u64 us = div_u64(ns, NSEC_PER_USEC);
+
+    usleep_range(us, us + ( us >> 3 ) + 1);
+  }
+}
+
+/******************************************************************************************************/
+/* adapter */
+
+static int oled_emu_master_xfer(struct i2c_adapter *adap, struct i2c_msg *msgs, int num)
+{
+  u64 ns;
+  int i;
+
+  mutex_lock(&emu_lock);
+
+  emu.xfers++;
+  ns = emu.bus_ns;
+
+  for( i = 0; i < num; i++ )
+  {
+    /* the panel only ACKs writes to its own address */
+    if( ( msgs[i].addr != emu_addr ) || ( msgs[i].flags & I2C_M_RD ) )
+    {
+      emu.nacks++;
+      OledEmu_Account(&emu, 0);
+      break;
+    }
+
+    OledEmu_Account(&emu, msgs[i].len);
+    OledEmu_Message(&emu, msgs[i].buf, msgs[i].len);
+  }
+
+  ns = emu.bus_ns - ns;
+
+  mutex_unlock(&emu_lock);
+
+  OledEmu_Sleep(ns);
+
+  return ( i == num ) ? num : -ENXIO;
+}
+
+/* SMBus-only adapter: I2C block writes and byte writes, command = control byte */
+static int oled_emu_smbus_xfer(struct i2c_adapter *adap, u16 addr, unsigned short flags,
+                               char read_write, u8 command, int size, union i2c_smbus_data *data)
+{
+  uint8_t      buf[1 + I2C_SMBUS_BLOCK_MAX];
+  unsigned int len;
+  u64          ns;
+
+  if( ( addr != emu_addr ) || ( read_write != I2C_SMBUS_WRITE ) )
+  {
+    mutex_lock(&emu_lock);
+    emu.xfers++;
+    emu.nacks++;
+    mutex_unlock(&emu_lock);
+    return -ENXIO;
+  }
+
+  buf[0] = command;
+  switch( size )
+  {
+    case I2C_SMBUS_BYTE_DATA:
+      buf[1] = data->byte;
+      len    = 2;
+      break;
+
+    case I2C_SMBUS_I2C_BLOCK_DATA:
+      len = min_t(unsigned int, data->block[0], I2C_SMBUS_BLOCK_MAX);
+      memcpy(&buf[1], &data->block[1], len);
+      len += 1;
+      break;
+
+    default:
+      return -EOPNOTSUPP;
+  }
+
+  mutex_lock(&emu_lock);
+
+  emu.xfers++;
+  ns = emu.bus_ns;
+  OledEmu_Account(&emu, len);
+  OledEmu_Message(&emu, buf, len);
+  ns = emu.bus_ns - ns;
+
+  mutex_unlock(&emu_lock);
+
+  OledEmu_Sleep(ns);
+
+  return 0;
+}
+
+static u32 oled_emu_functionality(struct i2c_adapter *adap)
+{
+  if( emu_smbus_only )
+  {
+    return I2C_FUNC_SMBUS_WRITE_BYTE_DATA | I2C_FUNC_SMBUS_WRITE_I2C_BLOCK;
+  }
+  return I2C_FUNC_I2C | I2C_FUNC_SMBUS_EMUL;
+}
+
+static const struct i2c_algorithm oled_emu_i2c_algo =
+{
+  .master_xfer   = oled_emu_master_xfer,
+  .functionality = oled_emu_functionality,
+};
+
+static const struct i2c_algorithm oled_emu_smbus_algo =
+{
+  .smbus_xfer    = oled_emu_smbus_xfer,
+  .functionality = oled_emu_functionality,
+};
+
+static struct i2c_adapter oled_emu_adapter =
+{
+  .owner = THIS_MODULE,
+  .class = 0,
+  .name  = "oled_i2c_emu",
+};
+
+/******************************************************************************************************/
+/* debugfs */
+
+static ssize_t oled_emu_fb_read(struct file *filp, char __user *buf, size_t len, loff_t *off)
+{
+  uint8_t  *fb;
+  ssize_t   ret;
+
+  fb = kmalloc(sizeof(emu.ram), GFP_KERNEL);
+  if( !fb )
+  {
+    return -ENOMEM;
+  }
+
+  mutex_lock(&emu_lock);
+  memcpy(fb, emu.ram, sizeof(emu.ram));
+  mutex_unlock(&emu_lock);
+
+  ret = simple_read_from_buffer(buf, len, off, fb, sizeof(emu.ram));
+  kfree(fb);
+
+  return ret;
+}
+
+static const struct file_operations oled_emu_fb_fops =
+{
+  .owner  = THIS_MODULE,
+  .read   = oled_emu_fb_read,
+  .llseek = default_llseek,
+};
+
+static int oled_emu_stats_show(struct seq_file *m, void *v)
+{
+  static const char * const modes[] = { "horizontal", "vertical", "page", "invalid" };
+
+  mutex_lock(&emu_lock);
+
+  seq_printf(m, "clock_hz:    %u\n",   emu_clock_hz);
+  seq_printf(m, "transfers:   %llu\n", emu.xfers);
+  seq_printf(m, "messages:    %llu\n", emu.msgs);
+  seq_printf(m, "bytes:       %llu\n", emu.bytes);
+  seq_printf(m, "data_bytes:  %llu\n", emu.data_bytes);
+  seq_printf(m, "cmd_bytes:   %llu\n", emu.cmd_bytes);
+  seq_printf(m, "bus_us:      %llu\n", div_u64(emu.bus_ns, NSEC_PER_USEC));
+  seq_printf(m, "frames:      %llu\n", emu.frames);
+  seq_printf(m, "nacks:       %llu\n", emu.nacks);
+  seq_printf(m, "mode:        %s\n",   modes[emu.mode & 0x03]);
+  seq_printf(m, "window:      col %u-%u page %u-%u\n", emu.col_start, emu.col_end, emu.page_start, emu.page_end);
+  seq_printf(m, "pointer:     col %u page %u\n", emu.col, emu.page);
+  seq_printf(m, "display:     %s%s contrast 0x%02x start line %u\n",
+             emu.display_on ? "on" : "off", emu.inverted ? " inverted" : "", emu.contrast, emu.start_line);
+  seq_printf(m, "scroll:      %s 0x%02x page %u-%u\n",
+             emu.scroll_active ? "active" : "off", emu.scroll_cmd, emu.scroll_start, emu.scroll_end);
+
+  mutex_unlock(&emu_lock);
+
+  return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(oled_emu_stats);
+
+static ssize_t oled_emu_reset_write(struct file *filp, const char __user *buf, size_t len, loff_t *off)
+{
+  mutex_lock(&emu_lock);
+
+  emu.xfers      = 0;
+  emu.msgs       = 0;
+  emu.bytes      = 0;
+  emu.data_bytes = 0;
+  emu.cmd_bytes  = 0;
+  emu.bus_ns     = 0;
+  emu.frames     = 0;
+  emu.nacks      = 0;
+
+  mutex_unlock(&emu_lock);
+
+  return len;
+}
+
+static const struct file_operations oled_emu_reset_fops =
+{
+  .owner = THIS_MODULE,
+  .write = oled_emu_reset_write,
+};
+
+/******************************************************************************************************/
+
+/* power-on state of the SSD1315 */
+static void OledEmu_Reset(struct oled_emu_state *s)
+{
+  memset(s, 0, sizeof(*s));
+  s->mode     = 2;
+  s->col_end  = OLED_EMU_MAX_SEG - 1;
+  s->page_end = OLED_EMU_MAX_PAGE - 1;
+  s->contrast = 0x7F;
+}
+
+/* module init func */
+static int __init oled_i2c_emu_init(void)
+{
+  struct i2c_board_info info = { I2C_BOARD_INFO(OLED_EMU_PANEL_NAME, 0) };
+  int ret;
+
+  pr_info("\n@frk: going to init...");
+
+  OledEmu_Reset(&emu);
+
+  oled_emu_adapter.algo = emu_smbus_only ? &oled_emu_smbus_algo : &oled_emu_i2c_algo;
+
+  ret = i2c_add_adapter(&oled_emu_adapter);
+  if( ret < 0 )
+  {
+    pr_err("\n Cannot add the I2C adapter. ");
+    return ret;
+  }
+
+  emu_debugfs = debugfs_create_dir("oled_i2c_emu", NULL);
+  debugfs_create_file("fb",    0444, emu_debugfs, NULL, &oled_emu_fb_fops);
+  debugfs_create_file("stats", 0444, emu_debugfs, NULL, &oled_emu_stats_fops);
+  debugfs_create_file("reset", 0200, emu_debugfs, NULL, &oled_emu_reset_fops);
+
+  if( emu_create_client )
+  {
+    info.addr  = emu_addr;
+    emu_client = i2c_new_client_device(&oled_emu_adapter, &info);
+    if( IS_ERR(emu_client) )
+    {
+      pr_err("\n Cannot create the panel client 0x%02x. ", emu_addr);
+      ret = PTR_ERR(emu_client);
+      goto r_adapter;
+    }
+  }
+
+  pr_info("\n @frk: I2C-oled emulator on bus %d, 0x%02x ... DONE!!! \n", i2c_adapter_id(&oled_emu_adapter), emu_addr);
+  return 0;
+
+r_adapter:
+  debugfs_remove_recursive(emu_debugfs);
+  i2c_del_adapter(&oled_emu_adapter);
+  return ret;
+}
+
+/* module exit func*/
+static void __exit oled_i2c_emu_exit(void)
+{
+  if( !IS_ERR_OR_NULL(emu_client) )
+  {
+    i2c_unregister_device(emu_client);
+  }
+  debugfs_remove_recursive(emu_debugfs);
+  i2c_del_adapter(&oled_emu_adapter);
+
+  pr_info("\n @frk: I2C-oled emulator remove ... DONE!!! \n");
+}
+
+/******************************************************************************************************/
+module_init(oled_i2c_emu_init);
+module_exit(oled_i2c_emu_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("FRANK <frank@bos-semi.com>");
+MODULE_DESCRIPTION("SSD1315 I2C EMULATOR");
+MODULE_VERSION("1.0");
+
+/******************************************************************************************************/
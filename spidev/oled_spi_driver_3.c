@@ -20,6 +20,28 @@
 #include <linux/gpio.h>
 #include <linux/err.h>
 #include <linux/spi/spi.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/ktime.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/mm.h>
+#include <linux/rmap.h>
+#include <linux/workqueue.h>
+#include <linux/hrtimer.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/jhash.h>
+#include <linux/random.h>
+#include <linux/firmware.h>
+#include <linux/list.h>
+
+/* glyph tables, generated from fonts/font_*.txt by fonts/fontgen (see Makefile) */
+#include "oled_fonts.h"
+/* panel geometry and the row-major <-> page-major conversion */
+#include "oled_transpose.h"
+/* built-in bitmaps, generated from assets/<name>.pbm by assets/assetgen (see Makefile) */
+#include "oled_assets.h"
 
 #include <linux/jiffies.h>
 
@@ -30,13 +52,8 @@ unsigned long old_jiffie = 0;
 #undef pr_fmt
 #define pr_fmt(fmt) "@frk-spi_device_driver: [%s] :" fmt,__func__
 
-/* sysfs */
-volatile int frk_spi_value = 1;
-volatile char* frk_spi_string = "Hallo to sysfs";
-
 dev_t dev = 0;
 static struct class *dev_class;
-static struct cdev frk_spi_cdev;
 struct kobject *kobj_ref;
 
 /* */
@@ -44,11 +61,45 @@ struct kobject *kobj_ref;
 #define OLED_SPI_BUS_AVAILABLE  0                 // SPI0 bus is used.
 #define SSH1106_RST_PIN         (  24 )           // RST (Reset pin), GPIO 24
 #define SSH1106_DC_PIN          (  23 )           // DC (Data/Command pin), GPIO 23
+#define SSH1106_MAX_PANELS      (   4 )           // panels driven by one module instance
+
+/*
+** Panels: one per chip-select given in frk_spi_cs. Panel N uses entry N of
+** frk_spi_bus, frk_spi_rst and frk_spi_dc, and gets /dev/frk_spi_deviceN
+** and /sys/kernel/frk_spi_sysfs/panelN. The defaults are the single panel
+** of the original wiring; more panels need a reset and a DC GPIO each.
+*/
+static int frk_spi_nr_panels = 1;
+static int frk_spi_nr_rst    = 1;
+static int frk_spi_nr_dc     = 1;
+static int frk_spi_cs[SSH1106_MAX_PANELS]  = { 1 };                          // CS1 is used.
+static int frk_spi_bus[SSH1106_MAX_PANELS] = { [0 ... SSH1106_MAX_PANELS - 1] = OLED_SPI_BUS_AVAILABLE };
+static int frk_spi_rst[SSH1106_MAX_PANELS] = { SSH1106_RST_PIN };
+static int frk_spi_dc[SSH1106_MAX_PANELS]  = { SSH1106_DC_PIN };
+module_param_array(frk_spi_cs, int, &frk_spi_nr_panels, 0444);
+MODULE_PARM_DESC(frk_spi_cs, "chip-select of each panel (default 1)");
+module_param_array(frk_spi_bus, int, NULL, 0444);
+MODULE_PARM_DESC(frk_spi_bus, "SPI bus of each panel (default 0)");
+module_param_array(frk_spi_rst, int, &frk_spi_nr_rst, 0444);
+MODULE_PARM_DESC(frk_spi_rst, "reset GPIO of each panel (default 24)");
+module_param_array(frk_spi_dc, int, &frk_spi_nr_dc, 0444);
+MODULE_PARM_DESC(frk_spi_dc, "DC GPIO of each panel (default 23)");
 
-/* SPI device */
-static struct spi_device* oled_spi_device;
+/*
+** Transport: 4-wire (8-bit words, DC GPIO) or 3-wire (9-bit words, the D/C
+** flag is the ninth bit). 3-wire falls back to 4-wire on the panels whose
+** SPI controller can't do 9-bit words.
+*/
+static bool frk_spi_3wire = false;
+module_param(frk_spi_3wire, bool, 0444);
+MODULE_PARM_DESC(frk_spi_3wire, "use the 9-bit 3-wire SPI mode (default N)");
 
-/* */
+/* boot splash: asset drawn by the bring-up instead of the default screen */
+static char *frk_spi_splash;
+module_param(frk_spi_splash, charp, 0444);
+MODULE_PARM_DESC(frk_spi_splash, "asset shown at bring-up, e.g. etx_logo (default: text screen)");
+
+/* template of the panels, bus_num and chip_select come from the parameters */
 static struct spi_board_info oled_info = 
 {
     .modalias       = "oled_spi_driver",
@@ -59,48 +110,619 @@ static struct spi_board_info oled_info =
 };
 
 /*******************************************************/
-void ETX_SSH1106_ClearDisplay( void );
-void display_rectangle(int len);
-void display_frank(void);
-void ETX_SSH1106_String(char *str);
-void ETX_SSH1106_SetCursor( uint8_t lineNo, uint8_t cursorPos );
+struct ssh1106_panel;
+
+void ETX_SSH1106_ClearDisplay( struct ssh1106_panel *panel );
+void display_rectangle(struct ssh1106_panel *panel, int len);
+void display_frank(struct ssh1106_panel *panel);
+void ETX_SSH1106_String(struct ssh1106_panel *panel, char *str);
+void ETX_SSH1106_StringFont( struct ssh1106_panel *panel, const char *str, unsigned int font_id, bool proportional );
+void ETX_SSH1106_SetCursor( struct ssh1106_panel *panel, uint8_t lineNo, uint8_t cursorPos );
+void ETX_SSH1106_Flush( struct ssh1106_panel *panel );
+int  ETX_SSH1106_Sync( struct ssh1106_panel *panel );
+int  ETX_SSH1106_DrawAsset( struct ssh1106_panel *panel, const char *name, int x, uint8_t page );
+static void ETX_SSH1106_fill( struct ssh1106_panel *panel, uint8_t data );
 
 /*************** Driver functions **********************/
 static int      frk_spi_open(struct inode *inode, struct file *file);
 static int      frk_spi_release(struct inode *inode, struct file *file);
 static ssize_t  frk_spi_read(struct file *filp, char __user *buf, size_t len,loff_t * off);
 static ssize_t  frk_spi_write(struct file *filp, const char *buf, size_t len, loff_t * off);
+static int      frk_spi_fsync(struct file *filp, loff_t start, loff_t end, int datasync);
+static int      frk_spi_mmap(struct file *filp, struct vm_area_struct *vma);
+
+/* Panel bring-up, deferred out of module init */
+static void     frk_spi_bringup_fn(struct work_struct *work);
+static void     frk_spi_defio_work_fn(struct work_struct *work);
+static void     frk_spi_retry_work_fn(struct work_struct *work);
+static void     frk_spi_anim_work_fn(struct work_struct *work);
+static enum hrtimer_restart frk_spi_anim_timer_fn(struct hrtimer *timer);
+static int      frk_spi_anim_start(struct ssh1106_panel *panel, unsigned int fps, bool loop);
+static void     frk_spi_anim_stop(struct ssh1106_panel *panel);
  
 /*************** Sysfs functions **********************/
 static ssize_t  sysfs_show(struct kobject *kobj, struct kobj_attribute *attr, char *buf);
 static ssize_t  sysfs_store(struct kobject *kobj, struct kobj_attribute *attr,const char *buf, size_t count);
 static ssize_t  sysfs_show_1(struct kobject *kobj, struct kobj_attribute *attr, char *buf);
 static ssize_t  sysfs_store_1(struct kobject *kobj, struct kobj_attribute *attr,const char *buf, size_t count);
+static ssize_t  sysfs_show_timing(struct kobject *kobj, struct kobj_attribute *attr, char *buf);
+static ssize_t  sysfs_show_format(struct kobject *kobj, struct kobj_attribute *attr, char *buf);
+static ssize_t  sysfs_store_format(struct kobject *kobj, struct kobj_attribute *attr,const char *buf, size_t count);
 struct kobj_attribute frk_spi_attr   = __ATTR(frk_spi_value, 0660, sysfs_show, sysfs_store);
 struct kobj_attribute frk_spi_attr_1 = __ATTR(frk_spi_string, 0660, sysfs_show_1, sysfs_store_1);
+struct kobj_attribute frk_spi_attr_timing = __ATTR(frk_spi_timing, 0440, sysfs_show_timing, NULL);
+static ssize_t  sysfs_show_dither(struct kobject *kobj, struct kobj_attribute *attr, char *buf);
+static ssize_t  sysfs_store_dither(struct kobject *kobj, struct kobj_attribute *attr,const char *buf, size_t count);
+static ssize_t  sysfs_show_asset(struct kobject *kobj, struct kobj_attribute *attr, char *buf);
+static ssize_t  sysfs_store_asset(struct kobject *kobj, struct kobj_attribute *attr,const char *buf, size_t count);
+static ssize_t  sysfs_show_anim(struct kobject *kobj, struct kobj_attribute *attr, char *buf);
+static ssize_t  sysfs_store_anim(struct kobject *kobj, struct kobj_attribute *attr,const char *buf, size_t count);
+static ssize_t  sysfs_show_font(struct kobject *kobj, struct kobj_attribute *attr, char *buf);
+static ssize_t  sysfs_store_font(struct kobject *kobj, struct kobj_attribute *attr,const char *buf, size_t count);
+struct kobj_attribute frk_spi_attr_format = __ATTR(frk_spi_format, 0660, sysfs_show_format, sysfs_store_format);
+struct kobj_attribute frk_spi_attr_dither = __ATTR(frk_spi_dither, 0660, sysfs_show_dither, sysfs_store_dither);
+struct kobj_attribute frk_spi_attr_asset  = __ATTR(frk_spi_asset, 0660, sysfs_show_asset, sysfs_store_asset);
+struct kobj_attribute frk_spi_attr_anim   = __ATTR(frk_spi_anim, 0660, sysfs_show_anim, sysfs_store_anim);
+struct kobj_attribute frk_spi_attr_font   = __ATTR(frk_spi_font, 0660, sysfs_show_font, sysfs_store_font);
 
 /* file operation structure */
 static struct file_operations fops = {
-  .owner = THIS_MODULE,
-  .read  = frk_spi_read,
-  .write = frk_spi_write,
-  .open  = frk_spi_release,
+  .owner   = THIS_MODULE,
+  .read    = frk_spi_read,
+  .write   = frk_spi_write,
+  .open    = frk_spi_open,
+  .release = frk_spi_release,
+  .fsync   = frk_spi_fsync,
+  .mmap    = frk_spi_mmap,
+  .llseek  = default_llseek,
+};
+
+/******************************************************************************************************/
+/* SSH1106-OLED headers */
+/******************************************************************************************************/
+#define SSH1106_MAX_LINE        (   7 )           // Maximum line
+#define SSH1106_DEF_FONT_SIZE   (   5 )           // Default font size
+
+/*
+** Shadow framebuffer: image of the 132x64 controller RAM, one byte per
+** segment per page. The drawing APIs only render into panel->buffer and
+** mark the touched pages in panel->dirty_pages (bit n = page n).
+** ETX_SSH1106_Flush() sends the dirty pages to the panel.
+** The buffer is a whole zeroed page so /dev/frk_spi_deviceN can mmap it;
+** panel->sent is the panel RAM as the queued frames leave it. The flush
+** diffs the dirty pages against it and sends only the changed column
+** windows; pages in panel->full_pages are sent whole (panel RAM unknown).
+*/
+#define SSH1106_FB_SIZE         ( SSH1106_MAX_PAGE * SSH1106_MAX_SEG )
+
+/*
+** Row-major 1bpp image (SSH1106_ROW_BYTES per row, see oled_transpose.h):
+** with frk_spi_format set to "row" the char device reads and writes this
+** layout (mmap stays page-major).
+*/
+#define SSH1106_ROWS_SIZE       ( SSH1106_MAX_PAGE * 8 * SSH1106_ROW_BYTES )
+
+/*
+** Grayscale input: "gray8" (one byte per pixel) or "xrgb8888" (one
+** native-endian u32 per pixel, luma = (77 R + 150 G + 29 B) / 256), 132x64,
+** rows top to bottom. A write lands in panel->image and the touched bands
+** of 8 rows are dithered straight into the shadow buffer by the
+** frk_spi_dither method; a read gives back the image last written.
+*/
+#define SSH1106_GRAY_SIZE       ( SSH1106_MAX_PAGE * 8 * SSH1106_MAX_SEG )
+#define SSH1106_XRGB_SIZE       ( SSH1106_GRAY_SIZE * 4 )
+
+/*
+** Animation: with frk_spi_format set to "anim" the char device takes a
+** sequence of page-major frames (SSH1106_FB_SIZE bytes each, a write at
+** offset 0 starts a new sequence) into driver memory. frk_spi_anim starts
+** and stops the playback: an hrtimer ticks at the frame rate and queues
+** a work item that copies the next frame into the shadow buffer and
+** flushes it, so only the bytes changed since the last frame go out.
+** A tick that finds the last frame still pending is skipped.
+*/
+#define SSH1106_ANIM_FRAMES     (  64 )
+#define SSH1106_ANIM_SIZE       ( SSH1106_ANIM_FRAMES * SSH1106_FB_SIZE )
+#define SSH1106_ANIM_MAX_FPS    ( 200 )
+
+enum ssh1106_format
+{
+  SSH1106_FMT_PAGE,
+  SSH1106_FMT_ROW,
+  SSH1106_FMT_GRAY8,
+  SSH1106_FMT_XRGB8888,
+  SSH1106_FMT_ANIM,
+};
+
+static const char * const SSH1106_FormatNames[] = { "page", "row", "gray8", "xrgb8888", "anim" };
+static const unsigned int SSH1106_FormatSize[]  = { SSH1106_FB_SIZE, SSH1106_ROWS_SIZE,
+                                                    SSH1106_GRAY_SIZE, SSH1106_XRGB_SIZE, SSH1106_ANIM_SIZE };
+
+enum ssh1106_dither
+{
+  SSH1106_DITHER_THRESHOLD,                         // lit from 128
+  SSH1106_DITHER_BAYER,                             // 4x4 ordered
+  SSH1106_DITHER_FS,                                // Floyd-Steinberg error diffusion
+};
+
+static const char * const SSH1106_DitherNames[] = { "threshold", "bayer", "fs" };
+
+/*
+** Delta windows. Opening a new window costs a 3 byte cursor run plus two
+** more spi_messages (~SSH1106_XFER_COST byte times each), so unchanged gaps
+** up to SSH1106_WINDOW_COST columns are sent rather than split.
+*/
+#define SSH1106_XFER_COST       (   8 )           // message setup cost, in byte times
+#define SSH1106_WINDOW_COST     ( 3 + ( 2 * SSH1106_XFER_COST ) )
+#define SSH1106_MAX_WINDOWS     ( DIV_ROUND_UP( SSH1106_MAX_SEG, SSH1106_WINDOW_COST + 2 ) )
+
+/* in 3-wire mode a window only costs its 3 cursor words */
+#define SSH1106_WINDOW_COST_3W  (   3 )
+#define SSH1106_MAX_WINDOWS_3W  ( DIV_ROUND_UP( SSH1106_MAX_SEG, SSH1106_WINDOW_COST_3W + 2 ) )
+
+/*
+** Frame submission queue. A flush copies the dirty pages into one of two
+** frame slots as a list of command/data runs and sends them with
+** spi_async(), so the caller returns as soon as the frame is queued.
+** Each run is its own spi_message: the completion handler switches the DC
+** line and starts the next run. panel->inflight is on the wire,
+** panel->queued waits behind it and is rebuilt in place when another
+** flush comes before it started. The frame buffers are kmalloc'ed at init
+** (DMA-safe).
+** In 3-wire mode the whole frame is one run of 9-bit words instead.
+*/
+#define SSH1106_FRAME_RUNS      ( SSH1106_MAX_PAGE * SSH1106_MAX_WINDOWS * 2 )  // cursor + data run per window
+#define SSH1106_FRAME_SIZE      ( SSH1106_MAX_PAGE * ( SSH1106_MAX_SEG + ( 3 * SSH1106_MAX_WINDOWS ) ) )
+#define SSH1106_FRAME_SIZE_3W   ( SSH1106_MAX_PAGE * ( SSH1106_MAX_SEG + ( 3 * SSH1106_MAX_WINDOWS_3W ) ) * 2 )
+#define SSH1106_FRAME_ALLOC     ( max( SSH1106_FRAME_SIZE, SSH1106_FRAME_SIZE_3W ) )
+#define SSH1106_RETRY_MS        (  20 )           // resend delay of the pages of a lost frame
+
+struct ssh1106_run
+{
+  bool                is_cmd;                       // DC level of this run
+  struct spi_transfer xfer;
+  struct spi_message  msg;
+};
+
+struct ssh1106_frame
+{
+  struct ssh1106_panel *panel;                      // panel the frame goes to
+  uint8_t            *buf;                          // DMA-safe tx buffer
+  unsigned int        len;                          // bytes used in buf
+  struct ssh1106_run  run[SSH1106_FRAME_RUNS];
+  unsigned int        nr_runs;
+  unsigned int        cur;                          // run on the wire
+  uint8_t             pages;                        // pages carried by the frame
+  u64                 seq;                          // fence number
+  ktime_t             start;
+  int16_t             addr_page;                    // controller address state before the frame
+  int16_t             addr_col;
+};
+
+/*
+** Command stream of the synchronous path (init, invert): consecutive bytes
+** of the same kind are grouped in a run and sent as one transfer, so DC
+** only switches at run boundaries. ETX_SSH1106_StreamFlush() sends the
+** pending run. The buffer is kmalloc'ed at init (DMA-safe).
+*/
+#define SSH1106_STREAM_SIZE     (  64 )           // bytes (32 words in 3-wire mode)
+
+/*
+** String render cache: the last string segments drawn (the chars of one
+** line) with the column bytes they render to, glyphs and spacers, for one
+** font size. A segment found here goes into the shadow buffer with one
+** memcpy instead of char by char. The least recently used entry is
+** replaced on a miss. Hit/miss counters are in debugfs.
+*/
+#define SSH1106_RCACHE_ENTRIES  (  16 )
+#define SSH1106_RCACHE_TEXT     (  32 )           // longest cached segment, in chars
+
+struct ssh1106_rcache_entry
+{
+  char                text[SSH1106_RCACHE_TEXT];
+  uint8_t             len;                          // chars, 0 = free entry
+  uint8_t             font_size;
+  uint8_t             ncols;                        // bytes in cols
+  u32                 hash;
+  unsigned long       used;                         // LRU stamp
+  uint8_t             cols[SSH1106_MAX_SEG];
+};
+
+/*
+** Per-panel state. Each panel has its own SPI device, reset/DC GPIOs,
+** shadow buffer, frame queue, char device and sysfs directory, and its
+** own lock: the panels only share the class and the major number, so
+** their flushes run in parallel.
+*/
+struct ssh1106_panel
+{
+  int                   id;                         // panel index, minor number
+  struct spi_device    *spi;
+  int                   rst_pin;                    // RST (Reset pin)
+  int                   dc_pin;                     // DC (Data/Command pin)
+  bool                  three_wire;                 // 9-bit words, D/C flag in bit 8
+
+  struct mutex          lock;                       // serializes the draw + flush sequences
+
+  /* Line Number and Cursor Position */
+  uint8_t               line_num;
+  uint8_t               cursor_pos;
+  uint8_t               font_size;
+  uint8_t               font_id;                    // oled_fonts[] of frk_spi_string, frk_spi_font
+  bool                  proportional;               // inked glyph widths instead of fixed cells
+
+  /* sysfs frk_spi_value and frk_spi_string, under lock */
+  int                   value;
+  char                  string[64];
+
+  /* shadow framebuffer */
+  uint8_t             (*buffer)[SSH1106_MAX_SEG];
+  uint8_t               sent[SSH1106_MAX_PAGE][SSH1106_MAX_SEG];
+  uint8_t               dirty_pages;
+  uint8_t               full_pages;
+  enum ssh1106_format   format;                     // char device format, frk_spi_format
+  enum ssh1106_dither   dither;                     // gray to 1bpp method, frk_spi_dither
+  uint8_t               rows[SSH1106_MAX_PAGE * 8][SSH1106_ROW_BYTES];  // row-major copy for read/write
+  void                 *image;                      // last gray8/xrgb8888 image written, SSH1106_XRGB_SIZE
+  uint8_t               gray[SSH1106_MAX_SEG];      // one xrgb8888 row as luma
+  int16_t               fs_err[2][SSH1106_MAX_SEG + 2];  // Floyd-Steinberg error of this/next row, x16
+
+  /*
+  ** The panel is brought up from a work item after the module is loaded.
+  ** Until ready is set the flushes send nothing: the drawing stays in the
+  ** shadow buffer (dirty pages) and is replayed by the bring-up work.
+  */
+  bool                  ready;
+  bool                  inverted;                   // last invert request
+
+  /* frame queue */
+  struct ssh1106_frame  frames[2];
+  struct ssh1106_frame *inflight;
+  struct ssh1106_frame *queued;
+  spinlock_t            queue_lock;
+  u64                   submit_seq;                 // last frame queued
+  u64                   done_seq;                   // last frame on the panel
+  wait_queue_head_t     fence_wq;
+
+  /* command stream */
+  struct
+  {
+    uint8_t            *buf;
+    unsigned int        len;                        // bytes used in buf
+    bool                is_cmd;                     // kind of the pending run
+  } stream;
+  int                   dc_level;                   // last DC level, -1 unknown
+
+  /*
+  ** Controller address state (page, column) as the frames built so far
+  ** leave it, -1 unknown. The cursor run of a window only carries the
+  ** commands that change it. A failed run sets addr_lost and drops the
+  ** queued frame, which was built on the address the failed one would
+  ** have left. The pages of both go to lost_pages (under queue_lock):
+  ** panel->sent counted them at build time, so retry_work flushes them
+  ** whole.
+  */
+  int16_t               addr_page;
+  int16_t               addr_col;
+  bool                  addr_lost;
+  uint8_t               lost_pages;
+
+  /* statistics of the last flush, reported by frk_spi_timing */
+  s64                   flush_us;
+  unsigned int          flush_bytes;
+  unsigned int          flush_xfers;
+  u64                   delta_saved;                // bytes not sent thanks to the delta encoding
+  unsigned int          dc_edges;                   // DC GPIO level changes
+  u64                   page_cmds_avoided;          // 0xB0|page commands not sent
+  u64                   col_cmds_avoided;           // column nibble commands not sent
+  s64                   convert_ns;                 // last gray8/xrgb8888 to 1bpp conversion
+
+  struct cdev           cdev;                       // /dev/frk_spi_device<id>
+  struct kobject       *kobj;                       // /sys/kernel/frk_spi_sysfs/panel<id>
+  struct work_struct    bringup_work;
+  struct delayed_work   defio_work;
+  struct delayed_work   retry_work;                 // resend of lost_pages
+
+  /* string render cache, under lock */
+  struct
+  {
+    struct ssh1106_rcache_entry entry[SSH1106_RCACHE_ENTRIES];
+    unsigned long       clock;                      // LRU stamp source
+    u64                 hits;
+    u64                 misses;
+    u64                 evictions;
+  } rcache;
+  struct dentry        *debugfs;                    // /sys/kernel/debug/frk_spi/panel<id>
+
+  /* animation player, under lock (running is also read by the timer) */
+  struct
+  {
+    uint8_t            *frames;                     // SSH1106_ANIM_SIZE, allocated by the first upload
+    unsigned int        nr;                         // whole frames uploaded
+    unsigned int        cur;                        // next frame to show
+    unsigned int        fps;
+    bool                loop;
+    bool                running;
+    struct hrtimer      timer;
+    struct work_struct  work;
+    u64                 shown;                      // frames flushed since start
+    atomic_t            skipped;                    // ticks dropped, bumped from the hrtimer
+  } anim;
+};
+
+static struct ssh1106_panel *SSH1106_Panels[SSH1106_MAX_PANELS];
+static struct dentry        *frk_spi_debugfs;      // /sys/kernel/debug/frk_spi
+
+/*
+** Assets: PackBits compressed page-major bitmaps, drawn by name into the
+** shadow buffer (see assets/assetgen.c for the format). The built-in ones
+** are oled_assets[]; any other name is loaded once with
+** request_firmware("frk_spi/<name>.oled") and kept on frk_spi_assets
+** until the module goes. Shared by all panels.
+*/
+#define SSH1106_ASSET_NAME      (  32 )
+#define SSH1106_ASSET_FW        "frk_spi/%s.oled"
+
+struct ssh1106_asset
+{
+  struct list_head    node;
+  struct oled_asset   asset;                        // name and data point into this entry
+  char                name[SSH1106_ASSET_NAME];
+  uint8_t             data[];
 };
 
+static LIST_HEAD(frk_spi_assets);
+static DEFINE_MUTEX(frk_spi_assets_lock);          // frk_spi_assets
+
 /*************** Sysfs functions ***************************************************************************/
+/*
+** The sysfs files of a panel live in its own directory: find the panel
+*/
+static struct ssh1106_panel *frk_spi_kobj_panel(struct kobject *kobj)
+{
+        int i;
+
+        for( i = 0; i < frk_spi_nr_panels; i++ )
+        {
+          if( SSH1106_Panels[i] && ( SSH1106_Panels[i]->kobj == kobj ) )
+          {
+            return SSH1106_Panels[i];
+          }
+        }
+
+        return NULL;
+}
+
 /*
 ** This function will be called when we read the sysfs file
 */
 static ssize_t sysfs_show(struct kobject *kobj, struct kobj_attribute *attr, char *buf)
 {
+        struct ssh1106_panel *panel = frk_spi_kobj_panel(kobj);
+        ssize_t               len;
+
         pr_info("Sysfs - Read!!!\n");
-        return sprintf(buf, "%d\n", frk_spi_value);
+        mutex_lock(&panel->lock);
+        len = sprintf(buf, "%d\n", panel->value);
+        mutex_unlock(&panel->lock);
+
+        return len;
 }
 
 static ssize_t sysfs_show_1(struct kobject *kobj, struct kobj_attribute *attr, char *buf)
 {
+        struct ssh1106_panel *panel = frk_spi_kobj_panel(kobj);
+        ssize_t               len;
+
         pr_info("Sysfs - Read!!!\n");
-        return sprintf(buf, "%s\n", frk_spi_string);
+        mutex_lock(&panel->lock);
+        len = sprintf(buf, "%s\n", panel->string);
+        mutex_unlock(&panel->lock);
+
+        return len;
+}
+
+/*
+** This function reports the duration and the bus traffic of the last flush
+*/
+static ssize_t sysfs_show_timing(struct kobject *kobj, struct kobj_attribute *attr, char *buf)
+{
+        struct ssh1106_panel *panel = frk_spi_kobj_panel(kobj);
+
+        return sprintf(buf, "flush_us: %lld\nbytes: %u\ntransfers: %u\ndelta_saved_bytes: %llu\ndc_edges: %u\n"
+                            "page_cmds_avoided: %llu\ncol_cmds_avoided: %llu\nconvert_ns: %lld\n",
+                       panel->flush_us, panel->flush_bytes, panel->flush_xfers,
+                       panel->delta_saved, panel->dc_edges,
+                       panel->page_cmds_avoided, panel->col_cmds_avoided, panel->convert_ns);
+}
+
+/*
+** frk_spi_format: layout of the char device, "page" (controller RAM order),
+** "row" (row-major bitmap), "gray8" or "xrgb8888"
+*/
+static ssize_t sysfs_show_format(struct kobject *kobj, struct kobj_attribute *attr, char *buf)
+{
+        struct ssh1106_panel *panel = frk_spi_kobj_panel(kobj);
+
+        return sprintf(buf, "%s\n", SSH1106_FormatNames[panel->format]);
+}
+
+static ssize_t sysfs_store_format(struct kobject *kobj, struct kobj_attribute *attr,const char *buf, size_t count)
+{
+        struct ssh1106_panel *panel = frk_spi_kobj_panel(kobj);
+        int                   format;
+
+        format = sysfs_match_string(SSH1106_FormatNames, buf);
+        if( format < 0 )
+        {
+          return format;
+        }
+
+        mutex_lock(&panel->lock);
+        panel->format = format;
+        mutex_unlock(&panel->lock);
+
+        return count;
+}
+
+/*
+** frk_spi_dither: gray8/xrgb8888 to 1bpp, "threshold", "bayer" or "fs"
+*/
+static ssize_t sysfs_show_dither(struct kobject *kobj, struct kobj_attribute *attr, char *buf)
+{
+        struct ssh1106_panel *panel = frk_spi_kobj_panel(kobj);
+
+        return sprintf(buf, "%s\n", SSH1106_DitherNames[panel->dither]);
+}
+
+static ssize_t sysfs_store_dither(struct kobject *kobj, struct kobj_attribute *attr,const char *buf, size_t count)
+{
+        struct ssh1106_panel *panel = frk_spi_kobj_panel(kobj);
+        int                   dither;
+
+        dither = sysfs_match_string(SSH1106_DitherNames, buf);
+        if( dither < 0 )
+        {
+          return dither;
+        }
+
+        mutex_lock(&panel->lock);
+        panel->dither = dither;
+        mutex_unlock(&panel->lock);
+
+        return count;
+}
+
+/*
+** frk_spi_font: font of frk_spi_string, "<name> [prop]" with a name of
+** oled_fonts[]. Fixed 5x7 is the built-in font with the render cache.
+*/
+static ssize_t sysfs_show_font(struct kobject *kobj, struct kobj_attribute *attr, char *buf)
+{
+        struct ssh1106_panel *panel = frk_spi_kobj_panel(kobj);
+
+        return sprintf(buf, "%s%s\n", oled_fonts[panel->font_id].name, panel->proportional ? " prop" : "");
+}
+static ssize_t sysfs_store_font(struct kobject *kobj, struct kobj_attribute *attr,const char *buf, size_t count)
+{
+        struct ssh1106_panel *panel = frk_spi_kobj_panel(kobj);
+        char                  name[16];
+        char                  mode[8] = "";
+        unsigned int          id;
+
+        if( sscanf(buf, "%15s %7s", name, mode) < 1 )
+        {
+          return -EINVAL;
+        }
+        for( id = 0; id < OLED_NR_FONTS; id++ )
+        {
+          if( strcmp(name, oled_fonts[id].name) == 0 )
+          {
+            break;
+          }
+        }
+        if( ( id == OLED_NR_FONTS ) || ( mode[0] && strcmp(mode, "prop") ) )
+        {
+          return -EINVAL;
+        }
+
+        mutex_lock(&panel->lock);
+        panel->font_id      = id;
+        panel->proportional = ( mode[0] != 0 );
+        mutex_unlock(&panel->lock);
+
+        return count;
+}
+
+/*
+** frk_spi_asset: read lists the assets, writing "<name> [x [page]]" draws
+** one (x -1 or left out = centered)
+*/
+static ssize_t sysfs_show_asset(struct kobject *kobj, struct kobj_attribute *attr, char *buf)
+{
+        struct ssh1106_asset *entry;
+        ssize_t               len = 0;
+        int                   i;
+
+        for( i = 0; i < OLED_NR_ASSETS; i++ )
+        {
+          len += scnprintf(buf + len, PAGE_SIZE - len, "%s %ux%u %u/%u built-in\n",
+                           oled_assets[i].name, oled_assets[i].width, oled_assets[i].pages * 8,
+                           oled_assets[i].len, oled_assets[i].width * oled_assets[i].pages);
+        }
+
+        mutex_lock(&frk_spi_assets_lock);
+        list_for_each_entry(entry, &frk_spi_assets, node)
+        {
+          len += scnprintf(buf + len, PAGE_SIZE - len, "%s %ux%u %u/%u firmware\n",
+                           entry->name, entry->asset.width, entry->asset.pages * 8,
+                           entry->asset.len, entry->asset.width * entry->asset.pages);
+        }
+        mutex_unlock(&frk_spi_assets_lock);
+
+        return len;
+}
+
+static ssize_t sysfs_store_asset(struct kobject *kobj, struct kobj_attribute *attr,const char *buf, size_t count)
+{
+        struct ssh1106_panel *panel = frk_spi_kobj_panel(kobj);
+        char                  name[SSH1106_ASSET_NAME];
+        int                   x    = -1;
+        int                   page = 0;
+        int                   ret;
+
+        if( ( sscanf(buf, "%31s %d %d", name, &x, &page) < 1 ) ||
+            ( x < -1 ) || ( x >= SSH1106_MAX_SEG ) || ( page < 0 ) || ( page >= SSH1106_MAX_PAGE ) )
+        {
+          return -EINVAL;
+        }
+
+        ret = ETX_SSH1106_DrawAsset(panel, name, x, page);
+
+        return ( ret < 0 ) ? ret : count;
+}
+
+/*
+** frk_spi_anim: "start <fps> [once]" plays the uploaded frames (looping
+** unless once), "stop" stops; read gives the player state
+*/
+static ssize_t sysfs_show_anim(struct kobject *kobj, struct kobj_attribute *attr, char *buf)
+{
+        struct ssh1106_panel *panel = frk_spi_kobj_panel(kobj);
+        ssize_t               len;
+
+        mutex_lock(&panel->lock);
+        len = sprintf(buf, "state: %s\nframes: %u\nfps: %u\nloop: %d\nshown: %llu\nskipped: %u\n",
+                      panel->anim.running ? "playing" : "stopped", panel->anim.nr, panel->anim.fps,
+                      panel->anim.loop, panel->anim.shown, (unsigned int)atomic_read(&panel->anim.skipped));
+        mutex_unlock(&panel->lock);
+
+        return len;
+}
+
+static ssize_t sysfs_store_anim(struct kobject *kobj, struct kobj_attribute *attr,const char *buf, size_t count)
+{
+        struct ssh1106_panel *panel = frk_spi_kobj_panel(kobj);
+        char                  mode[8] = "";
+        unsigned int          fps;
+        int                   ret;
+
+        if( sysfs_streq(buf, "stop") )
+        {
+          frk_spi_anim_stop(panel);
+          return count;
+        }
+
+        if( ( sscanf(buf, "start %u %7s", &fps, mode) < 1 ) ||
+            ( fps == 0 ) || ( fps > SSH1106_ANIM_MAX_FPS ) ||
+            ( mode[0] && strcmp(mode, "once") ) )
+        {
+          return -EINVAL;
+        }
+
+        ret = frk_spi_anim_start(panel, fps, ( mode[0] == '\0' ));
+
+        return ( ret < 0 ) ? ret : count;
 }
 
 /*
@@ -108,51 +730,80 @@ static ssize_t sysfs_show_1(struct kobject *kobj, struct kobj_attribute *attr, c
 */
 static ssize_t sysfs_store(struct kobject *kobj, struct kobj_attribute *attr,const char *buf, size_t count)
 {
+      struct ssh1106_panel *panel = frk_spi_kobj_panel(kobj);
+      int                   value;
+
       pr_info("Sysfs - Write!!!\n");
 
       /* get update spi_value from user space */
-      sscanf(buf,"%d\n",&frk_spi_value);
+      if( sscanf(buf,"%d\n",&value) != 1 )
+      {
+        return -EINVAL;
+      }
 
-      if( frk_spi_value ) 
+      mutex_lock(&panel->lock);
+      panel->value = value;
+      if( panel->value ) 
       {
         // Clear the display
-        ETX_SSH1106_ClearDisplay();
+        ETX_SSH1106_ClearDisplay(panel);
         /* display rectangle */
-        display_rectangle(7);       
+        display_rectangle(panel, 7);       
         /* display Frank*/
-        display_frank();
+        display_frank(panel);
+        /* push the changed pages to the panel */
+        ETX_SSH1106_Flush(panel);
       }
 
       #if 0
       else {
         // Clear the display
-        ETX_SSH1106_ClearDisplay();
+        ETX_SSH1106_ClearDisplay(panel);
         //
-        ETX_SSH1106_SetCursor(3,15);
+        ETX_SSH1106_SetCursor(panel, 3,15);
         // display string
-        ETX_SSH1106_String(frk_spi_string);
+        ETX_SSH1106_String(panel, panel->string);
       }
       #endif
+      mutex_unlock(&panel->lock);
 
         return count;
 }
 
 static ssize_t sysfs_store_1(struct kobject *kobj, struct kobj_attribute *attr,const char *buf, size_t count)
 {
+      struct ssh1106_panel *panel = frk_spi_kobj_panel(kobj);
+      char                  string[sizeof(panel->string)];
+
       pr_info("Sysfs - Write!!!\n");
 
-      /* get update spi_value from user space */
-      sscanf(buf,"%s",&frk_spi_string);
+      /* get update spi_string from user space */
+      if( sscanf(buf,"%63s",string) != 1 )
+      {
+        return -EINVAL;
+      }
 
-      if( frk_spi_value ) 
+      mutex_lock(&panel->lock);
+      strscpy(panel->string, string, sizeof(panel->string));
+      if( panel->value ) 
       {
         // Clear the display
-        ETX_SSH1106_ClearDisplay();
+        ETX_SSH1106_ClearDisplay(panel);
         //
-        ETX_SSH1106_SetCursor(3,15);
-        // display string
-        ETX_SSH1106_String(frk_spi_string);
+        ETX_SSH1106_SetCursor(panel, 3,15);
+        // display string, in the font picked by frk_spi_font
+        if( ( panel->font_id == OLED_FONT_5X7 ) && !panel->proportional )
+        {
+          ETX_SSH1106_String(panel, panel->string);
+        }
+        else
+        {
+          ETX_SSH1106_StringFont(panel, panel->string, panel->font_id, panel->proportional);
+        }
+        /* push the changed pages to the panel */
+        ETX_SSH1106_Flush(panel);
       }
+      mutex_unlock(&panel->lock);
 
         return count;
 }
@@ -163,6 +814,8 @@ static ssize_t sysfs_store_1(struct kobject *kobj, struct kobj_attribute *attr,c
 */ 
 static int frk_spi_open(struct inode *inode, struct file *file)
 {
+        file->private_data = container_of(inode->i_cdev, struct ssh1106_panel, cdev);
+
         pr_info("Device File Opened...!!!\n");
         return 0;
 }
@@ -176,38 +829,18 @@ static int frk_spi_release(struct inode *inode, struct file *file)
 }
  
 /*
-** This function will be called when we read the Device file
-*/
-static ssize_t frk_spi_read(struct file *filp, char __user *buf, size_t len, loff_t *off)
-{
-        pr_info("Read function\n");
-        return 0;
-}
-/*
-** This function will be called when we write the Device file
+** This function will be called when we fsync the Device file.
+** It waits until every frame queued so far is on the panel.
 */
-static ssize_t frk_spi_write(struct file *filp, const char __user *buf, size_t len, loff_t *off)
+static int frk_spi_fsync(struct file *filp, loff_t start, loff_t end, int datasync)
 {
-        pr_info("Write Function\n");
-        return len;
-}
-
-/******************************************************************************************************/
-/* SSH1106-OLED headers */
-/******************************************************************************************************/
-#define SSH1106_MAX_SEG         ( 132 )           // Maximum segment
-
-#define SSH1106_MAX_LINE        (   7 )           // Maximum line
-#define SSH1106_DEF_FONT_SIZE   (   5 )           // Default font size
+        struct ssh1106_panel *panel = filp->private_data;
 
-/*
-** Variable to store Line Number and Cursor Position.
-*/ 
-static uint8_t SSH1106_LineNum   = 0;
-static uint8_t SSH1106_CursorPos = 0;
-static uint8_t SSH1106_FontSize  = SSH1106_DEF_FONT_SIZE;
+        /* the draws done before bring-up are only queued by its work */
+        flush_work(&panel->bringup_work);
 
-static void ETX_SSH1106_fill( uint8_t data );
+        return ETX_SSH1106_Sync(panel);
+}
 
 /* OLED EED1106 APIs, from EmbedTronix */
 /****************************************************************************
@@ -215,12 +848,12 @@ static void ETX_SSH1106_fill( uint8_t data );
  *
  * Details : This function writes the 1-byte data to the slave device using SPI.
  ****************************************************************************/
-int frk_spi_spi_write( uint8_t data )
+int frk_spi_spi_write( struct ssh1106_panel *panel, uint8_t data )
 {
   int     ret = -1;
   uint8_t rx  = 0x00;
   
-  if( oled_spi_device )
+  if( panel->spi )
   {    
   
     struct spi_transfer  tr = 
@@ -230,7 +863,7 @@ int frk_spi_spi_write( uint8_t data )
       .len     = 1,
     };
   
-    spi_sync_transfer( oled_spi_device, &tr, 1 );
+    spi_sync_transfer( panel->spi, &tr, 1 );
   }
   
   //pr_info("Received = 0x%02X \n", rx);
@@ -238,114 +871,41 @@ int frk_spi_spi_write( uint8_t data )
   return( ret );
 }
 
-/*
-** Array Variable to store the letters.
-*/ 
-static const unsigned char SSH1106_font[][SSH1106_DEF_FONT_SIZE]= 
-{
-    {0x00, 0x00, 0x00, 0x00, 0x00},   // space
-    {0x00, 0x00, 0x2f, 0x00, 0x00},   // !
-    {0x00, 0x07, 0x00, 0x07, 0x00},   // "
-    {0x14, 0x7f, 0x14, 0x7f, 0x14},   // #
-    {0x24, 0x2a, 0x7f, 0x2a, 0x12},   // $
-    {0x23, 0x13, 0x08, 0x64, 0x62},   // %
-    {0x36, 0x49, 0x55, 0x22, 0x50},   // &
-    {0x00, 0x05, 0x03, 0x00, 0x00},   // '
-    {0x00, 0x1c, 0x22, 0x41, 0x00},   // (
-    {0x00, 0x41, 0x22, 0x1c, 0x00},   // )
-    {0x14, 0x08, 0x3E, 0x08, 0x14},   // *
-    {0x08, 0x08, 0x3E, 0x08, 0x08},   // +
-    {0x00, 0x00, 0xA0, 0x60, 0x00},   // ,
-    {0x08, 0x08, 0x08, 0x08, 0x08},   // -
-    {0x00, 0x60, 0x60, 0x00, 0x00},   // .
-    {0x20, 0x10, 0x08, 0x04, 0x02},   // /
-    {0x3E, 0x51, 0x49, 0x45, 0x3E},   // 0
-    {0x00, 0x42, 0x7F, 0x40, 0x00},   // 1
-    {0x42, 0x61, 0x51, 0x49, 0x46},   // 2
-    {0x21, 0x41, 0x45, 0x4B, 0x31},   // 3
-    {0x18, 0x14, 0x12, 0x7F, 0x10},   // 4
-    {0x27, 0x45, 0x45, 0x45, 0x39},   // 5
-    {0x3C, 0x4A, 0x49, 0x49, 0x30},   // 6
-    {0x01, 0x71, 0x09, 0x05, 0x03},   // 7
-    {0x36, 0x49, 0x49, 0x49, 0x36},   // 8
-    {0x06, 0x49, 0x49, 0x29, 0x1E},   // 9
-    {0x00, 0x36, 0x36, 0x00, 0x00},   // :
-    {0x00, 0x56, 0x36, 0x00, 0x00},   // ;
-    {0x08, 0x14, 0x22, 0x41, 0x00},   // <
-    {0x14, 0x14, 0x14, 0x14, 0x14},   // =
-    {0x00, 0x41, 0x22, 0x14, 0x08},   // >
-    {0x02, 0x01, 0x51, 0x09, 0x06},   // ?
-    {0x32, 0x49, 0x59, 0x51, 0x3E},   // @
-    {0x7C, 0x12, 0x11, 0x12, 0x7C},   // A
-    {0x7F, 0x49, 0x49, 0x49, 0x36},   // B
-    {0x3E, 0x41, 0x41, 0x41, 0x22},   // C
-    {0x7F, 0x41, 0x41, 0x22, 0x1C},   // D
-    {0x7F, 0x49, 0x49, 0x49, 0x41},   // E
-    {0x7F, 0x09, 0x09, 0x09, 0x01},   // F
-    {0x3E, 0x41, 0x49, 0x49, 0x7A},   // G
-    {0x7F, 0x08, 0x08, 0x08, 0x7F},   // H
-    {0x00, 0x41, 0x7F, 0x41, 0x00},   // I
-    {0x20, 0x40, 0x41, 0x3F, 0x01},   // J
-    {0x7F, 0x08, 0x14, 0x22, 0x41},   // K
-    {0x7F, 0x40, 0x40, 0x40, 0x40},   // L
-    {0x7F, 0x02, 0x0C, 0x02, 0x7F},   // M
-    {0x7F, 0x04, 0x08, 0x10, 0x7F},   // N
-    {0x3E, 0x41, 0x41, 0x41, 0x3E},   // O
-    {0x7F, 0x09, 0x09, 0x09, 0x06},   // P
-    {0x3E, 0x41, 0x51, 0x21, 0x5E},   // Q
-    {0x7F, 0x09, 0x19, 0x29, 0x46},   // R
-    {0x46, 0x49, 0x49, 0x49, 0x31},   // S
-    {0x01, 0x01, 0x7F, 0x01, 0x01},   // T
-    {0x3F, 0x40, 0x40, 0x40, 0x3F},   // U
-    {0x1F, 0x20, 0x40, 0x20, 0x1F},   // V
-    {0x3F, 0x40, 0x38, 0x40, 0x3F},   // W
-    {0x63, 0x14, 0x08, 0x14, 0x63},   // X
-    {0x07, 0x08, 0x70, 0x08, 0x07},   // Y
-    {0x61, 0x51, 0x49, 0x45, 0x43},   // Z
-    {0x00, 0x7F, 0x41, 0x41, 0x00},   // [
-    {0x55, 0xAA, 0x55, 0xAA, 0x55},   // Backslash (Checker pattern)
-    {0x00, 0x41, 0x41, 0x7F, 0x00},   // ]
-    {0x04, 0x02, 0x01, 0x02, 0x04},   // ^
-    {0x40, 0x40, 0x40, 0x40, 0x40},   // _
-    {0x00, 0x03, 0x05, 0x00, 0x00},   // `
-    {0x20, 0x54, 0x54, 0x54, 0x78},   // a
-    {0x7F, 0x48, 0x44, 0x44, 0x38},   // b
-    {0x38, 0x44, 0x44, 0x44, 0x20},   // c
-    {0x38, 0x44, 0x44, 0x48, 0x7F},   // d
-    {0x38, 0x54, 0x54, 0x54, 0x18},   // e
-    {0x08, 0x7E, 0x09, 0x01, 0x02},   // f
-    {0x18, 0xA4, 0xA4, 0xA4, 0x7C},   // g
-    {0x7F, 0x08, 0x04, 0x04, 0x78},   // h
-    {0x00, 0x44, 0x7D, 0x40, 0x00},   // i
-    {0x40, 0x80, 0x84, 0x7D, 0x00},   // j
-    {0x7F, 0x10, 0x28, 0x44, 0x00},   // k
-    {0x00, 0x41, 0x7F, 0x40, 0x00},   // l
-    {0x7C, 0x04, 0x18, 0x04, 0x78},   // m
-    {0x7C, 0x08, 0x04, 0x04, 0x78},   // n
-    {0x38, 0x44, 0x44, 0x44, 0x38},   // o
-    {0xFC, 0x24, 0x24, 0x24, 0x18},   // p
-    {0x18, 0x24, 0x24, 0x18, 0xFC},   // q
-    {0x7C, 0x08, 0x04, 0x04, 0x08},   // r
-    {0x48, 0x54, 0x54, 0x54, 0x20},   // s
-    {0x04, 0x3F, 0x44, 0x40, 0x20},   // t
-    {0x3C, 0x40, 0x40, 0x20, 0x7C},   // u
-    {0x1C, 0x20, 0x40, 0x20, 0x1C},   // v
-    {0x3C, 0x40, 0x30, 0x40, 0x3C},   // w
-    {0x44, 0x28, 0x10, 0x28, 0x44},   // x
-    {0x1C, 0xA0, 0xA0, 0xA0, 0x7C},   // y
-    {0x44, 0x64, 0x54, 0x4C, 0x44},   // z
-    {0x00, 0x10, 0x7C, 0x82, 0x00},   // {
-    {0x00, 0x00, 0xFF, 0x00, 0x00},   // |
-    {0x00, 0x82, 0x7C, 0x10, 0x00},   // }
-    {0x00, 0x06, 0x09, 0x09, 0x06}    // ~ (Degrees)
-};
+/****************************************************************************
+ * Name: frk_spi_spi_write_buf
+ *
+ * Details : This function writes a run of bytes to the slave device as one
+ *           tx-only SPI message. The buffer has to be DMA-safe.
+ ****************************************************************************/
+int frk_spi_spi_write_buf( struct ssh1106_panel *panel, const uint8_t *buf, size_t len )
+{
+  int ret = -ENODEV;
+
+  if( panel->spi )
+  {
+    struct spi_transfer  tr = 
+    {
+      .tx_buf  = buf,
+      .len     = len,
+    };
+    struct spi_message   msg;
+
+    spi_message_init( &msg );
+    spi_message_add_tail( &tr, &msg );
+
+    ret = spi_sync( panel->spi, &msg );
+  }
+
+  return( ret );
+}
+
 
 /****************************************************************************
  * Name: ETX_SSH1106_ResetDcInit
  *
  * Details : This function Initializes and Configures the Reset and DC Pin
  ****************************************************************************/
-static int ETX_SSH1106_ResetDcInit( void )
+static int ETX_SSH1106_ResetDcInit( struct ssh1106_panel *panel )
 {
   int ret = 0;
     
@@ -356,46 +916,46 @@ static int ETX_SSH1106_ResetDcInit( void )
     /* Register the Reset GPIO */
     
     //Checking the Reset GPIO is valid or not
-    if( gpio_is_valid( SSH1106_RST_PIN ) == false )
+    if( gpio_is_valid( panel->rst_pin ) == false )
     {
-      pr_err("Reset GPIO %d is not valid\n", SSH1106_RST_PIN);
+      pr_err("Reset GPIO %d is not valid\n", panel->rst_pin);
       ret = -1;
       break;
     }
     
     //Requesting the Reset GPIO
-    if( gpio_request( SSH1106_RST_PIN, "SSH1106_RST_PIN" ) < 0 )
+    if( gpio_request( panel->rst_pin, "SSH1106_RST_PIN" ) < 0 )
     {
-      pr_err("ERROR: Reset GPIO %d request\n", SSH1106_RST_PIN);
+      pr_err("ERROR: Reset GPIO %d request\n", panel->rst_pin);
       ret = -1;
       break;
     }
     
     //configure the Reset GPIO as output
-    gpio_direction_output( SSH1106_RST_PIN, 1 );
+    gpio_direction_output( panel->rst_pin, 1 );
     
     /* Register the DC GPIO */
     
     //Checking the DC GPIO is valid or not
-    if( gpio_is_valid( SSH1106_DC_PIN ) == false )
+    if( gpio_is_valid( panel->dc_pin ) == false )
     {
-      pr_err("DC GPIO %d is not valid\n", SSH1106_DC_PIN);
-      gpio_free( SSH1106_RST_PIN );   // free the reset GPIO
+      pr_err("DC GPIO %d is not valid\n", panel->dc_pin);
+      gpio_free( panel->rst_pin );   // free the reset GPIO
       ret = -1;
       break;
     }
     
     //Requesting the DC GPIO
-    if( gpio_request( SSH1106_DC_PIN, "SSH1106_DC_PIN" ) < 0 )
+    if( gpio_request( panel->dc_pin, "SSH1106_DC_PIN" ) < 0 )
     {
-      pr_err("ERROR: DC GPIO %d request\n", SSH1106_DC_PIN);
-      gpio_free( SSH1106_RST_PIN );   // free the reset GPIO
+      pr_err("ERROR: DC GPIO %d request\n", panel->dc_pin);
+      gpio_free( panel->rst_pin );   // free the reset GPIO
       ret = -1;
       break;
     }
     
     //configure the Reset GPIO as output
-    gpio_direction_output( SSH1106_DC_PIN, 1 );
+    gpio_direction_output( panel->dc_pin, 1 );
     
   } while( false );
   
@@ -408,10 +968,10 @@ static int ETX_SSH1106_ResetDcInit( void )
  *
  * Details : This function De-initializes the Reset and DC Pin
  ****************************************************************************/
-static void ETX_SSH1106_ResetDcDeInit( void )
+static void ETX_SSH1106_ResetDcDeInit( struct ssh1106_panel *panel )
 {
-  gpio_free( SSH1106_RST_PIN );   // free the reset GPIO
-  gpio_free( SSH1106_DC_PIN );    // free the DC GPIO
+  gpio_free( panel->rst_pin );   // free the reset GPIO
+  gpio_free( panel->dc_pin );    // free the DC GPIO
 }
 
 /****************************************************************************
@@ -423,9 +983,9 @@ static void ETX_SSH1106_ResetDcDeInit( void )
  *            value - value to be set ( 0 or 1 )
  * 
  ****************************************************************************/
-static void ETX_SSH1106_setRst( uint8_t value )
+static void ETX_SSH1106_setRst( struct ssh1106_panel *panel, uint8_t value )
 {
-  gpio_set_value( SSH1106_RST_PIN, value );
+  gpio_set_value( panel->rst_pin, value );
 }
 
 /****************************************************************************
@@ -437,15 +997,53 @@ static void ETX_SSH1106_setRst( uint8_t value )
  *            value - value to be set ( 0 or 1 )
  * 
  ****************************************************************************/
-static void ETX_SSH1106_setDc( uint8_t value )
+static void ETX_SSH1106_setDc( struct ssh1106_panel *panel, uint8_t value )
+{
+  //the pin keeps its level between runs: skip the redundant writes
+  if( panel->dc_level == value )
+  {
+    return;
+  }
+
+  gpio_set_value( panel->dc_pin, value );
+  panel->dc_level = value;
+  panel->dc_edges++;
+}
+
+/****************************************************************************
+ * Name: ETX_SSH1106_StreamFlush
+ *
+ * Details : This function sends the pending run of the command stream in
+ *           one transfer.
+ ****************************************************************************/
+static int ETX_SSH1106_StreamFlush( struct ssh1106_panel *panel )
 {
-  gpio_set_value( SSH1106_DC_PIN, value );
+  int ret;
+
+  if( panel->stream.len == 0 )
+  {
+    return( 0 );
+  }
+
+  //DC pin low for commands, high for data (in-band in 3-wire mode)
+  if( !panel->three_wire )
+  {
+    ETX_SSH1106_setDc( panel, panel->stream.is_cmd ? 0u : 1u );
+  }
+
+  ret = frk_spi_spi_write_buf( panel, panel->stream.buf, panel->stream.len );
+
+  panel->stream.len = 0;
+
+  return( ret );
 }
 
 /****************************************************************************
  * Name: ETX_SSH1106_Write
  *
- * Details : This function sends the command/data to the Display
+ * Details : This function queues the command/data in the command stream.
+ *           The run goes out when the kind changes, the buffer is full or
+ *           on ETX_SSH1106_StreamFlush().
  *
  * Argument: is_cmd
  *              true  - if we need to send command
@@ -453,79 +1051,279 @@ static void ETX_SSH1106_setDc( uint8_t value )
  *           value
  *              value to be transmitted
  ****************************************************************************/
-static int ETX_SSH1106_Write( bool is_cmd, uint8_t data )
+static int ETX_SSH1106_Write( struct ssh1106_panel *panel, bool is_cmd, uint8_t data )
 {
-  int     ret = 0;
-  uint8_t pin_value;
-  if( is_cmd )
+  int ret = 0;
+
+  //a new run starts when the kind changes (D/C is in-band in 3-wire mode)
+  if( ( panel->stream.len > 0 ) && !panel->three_wire && ( is_cmd != panel->stream.is_cmd ) )
   {
-    //DC pin has to be low, if this is command.
-    pin_value = 0u;
+    ret = ETX_SSH1106_StreamFlush(panel);
   }
-  else
+
+  if( ( panel->stream.len + sizeof(uint16_t) ) > SSH1106_STREAM_SIZE )
   {
-    //DC pin has to be high, if this is data.
-    pin_value = 1u;
+    ret = ETX_SSH1106_StreamFlush(panel);
   }
   
-  ETX_SSH1106_setDc( pin_value );
-  
   //pr_info("Writing 0x%02X \n", data);
   
-  //send the byte
-  ret = frk_spi_spi_write( data );
+  if( panel->three_wire )
+  {
+    //9-bit word, D/C in bit 8
+    uint16_t word = data | ( is_cmd ? 0x000 : 0x100 );
+
+    memcpy( panel->stream.buf + panel->stream.len, &word, sizeof(word) );
+    panel->stream.len += sizeof(word);
+  }
+  else
+  {
+    panel->stream.buf[panel->stream.len++] = data;
+  }
+
+  panel->stream.is_cmd = is_cmd;
   
   return( ret );
 }
 
+static void ETX_SSH1106_FrameDone( struct ssh1106_frame *frame, bool lost );
+static void ETX_SSH1106_RunComplete( void *context );
+
 /****************************************************************************
- * Name: ETX_SSH1106_SetCursor
+ * Name: ETX_SSH1106_FrameAddRun
  *
- * Details : This function is specific to the SSD_1306 OLED.
+ * Details : This function appends a run of command/data bytes to the frame
+ *           as its own spi_message.
  *
- * Argument:
- *              lineNo    -> Line Number
- *              cursorPos -> Cursor Position
- * 
+ * Argument: frame
+ *              frame being built (not queued yet)
+ *           is_cmd
+ *              true  - command run
+ *              false - data run
+ *           data, len
+ *              bytes of the run
  ****************************************************************************/
-void ETX_SSH1106_SetCursor( uint8_t lineNo, uint8_t cursorPos )
+static void ETX_SSH1106_FrameAddRun( struct ssh1106_frame *frame, bool is_cmd,
+                                     const uint8_t *data, unsigned int len )
 {
-
-  /* Move the Cursor to specified position only if it is in range */
-  if((lineNo <= SSH1106_MAX_LINE) && (cursorPos < SSH1106_MAX_SEG))
+  struct ssh1106_panel *panel = frame->panel;
+  struct ssh1106_run   *run;
+  uint16_t             *word;
+  unsigned int          i;
+
+  //same DC level as the last run (or D/C in-band): extend the last run,
+  //its bytes end right where these ones go
+  if( ( frame->nr_runs > 0 ) &&
+      ( panel->three_wire || ( frame->run[frame->nr_runs - 1].is_cmd == is_cmd ) ) )
   {
+    run = &frame->run[frame->nr_runs - 1];
+  }
+  else
+  {
+    run = &frame->run[frame->nr_runs++];
 
-    SSH1106_LineNum   = lineNo;                    // Save the specified line number
-    SSH1106_CursorPos = cursorPos;                 // Save the specified cursor position
-    
-    /* set page address */
-    ETX_SSH1106_Write(true, 0xB0 | lineNo);
-
-    /* set column address */
-    ETX_SSH1106_Write(true, 0x00 | (cursorPos&0x0F));            // column start addr
-    ETX_SSH1106_Write(true, 0x10 | ( (cursorPos>>4) + 0x10));    // column end addr
+    memset( &run->xfer, 0, sizeof(run->xfer) );
+    run->is_cmd      = is_cmd;
+    run->xfer.tx_buf = panel->three_wire ? frame->buf : ( frame->buf + frame->len );
 
+    spi_message_init( &run->msg );
+    spi_message_add_tail( &run->xfer, &run->msg );
+    run->msg.complete = ETX_SSH1106_RunComplete;
+    run->msg.context  = frame;
   }
-}
 
-/****************************************************************************
- * Name: ETX_SSH1106_GoToNextLine
- *
- * Details : This function is specific to the SSD_1306 OLED and move the cursor 
+  if( panel->three_wire )
+  {
+    //one 9-bit transfer for the whole frame, D/C in bit 8 of each word
+    word = (uint16_t *)frame->buf + frame->len;
+
+    for( i = 0; i < len; i++ )
+    {
+      word[i] = data[i] | ( is_cmd ? 0x000 : 0x100 );
+    }
+
+    run->xfer.len          += len * sizeof(uint16_t);
+    run->xfer.bits_per_word = 9;
+  }
+  else
+  {
+    memcpy( frame->buf + frame->len, data, len );
+
+    run->xfer.len          += len;
+  }
+
+  frame->len += len;
+}
+
+/****************************************************************************
+ * Name: ETX_SSH1106_FrameStart
+ *
+ * Details : This function sets the DC line for the current run of the frame
+ *           and hands the run to spi_async(). Safe in atomic context.
+ ****************************************************************************/
+static void ETX_SSH1106_FrameStart( struct ssh1106_frame *frame )
+{
+  struct ssh1106_panel *panel = frame->panel;
+  struct ssh1106_run   *run   = &frame->run[frame->cur];
+  int                   ret;
+
+  //DC pin low for commands, high for data (in-band in 3-wire mode)
+  if( !panel->three_wire )
+  {
+    ETX_SSH1106_setDc( panel, run->is_cmd ? 0u : 1u );
+  }
+
+  ret = spi_async( panel->spi, &run->msg );
+  if( ret )
+  {
+    pr_err("spi_async failed (%d), frame %llu dropped\n", ret, frame->seq);
+    ETX_SSH1106_FrameDone( frame, true );
+  }
+}
+
+/****************************************************************************
+ * Name: ETX_SSH1106_FrameDone
+ *
+ * Details : This function retires the frame on the wire, wakes up the
+ *           waiters of its fence and starts the queued frame, if any.
+ *           A lost frame leaves the controller address unknown: the
+ *           queued frame, built on the address the lost one would have
+ *           left, is dropped too, and the pages of both are resent whole
+ *           with full address commands from retry_work.
+ *
+ * Argument: frame
+ *              frame on the wire (completion context)
+ *           lost
+ *              true - a run of the frame failed
+ ****************************************************************************/
+static void ETX_SSH1106_FrameDone( struct ssh1106_frame *frame, bool lost )
+{
+  struct ssh1106_panel *panel = frame->panel;
+  struct ssh1106_frame *next;
+  unsigned long         flags;
+
+  panel->flush_us = ktime_us_delta( ktime_get(), frame->start );
+
+  spin_lock_irqsave( &panel->queue_lock, flags );
+  panel->done_seq = frame->seq;
+  next            = panel->queued;
+  panel->queued   = NULL;
+  if( lost )
+  {
+    WRITE_ONCE( panel->addr_lost, true );
+    panel->lost_pages |= frame->pages;
+    if( next )
+    {
+      panel->lost_pages |= next->pages;
+      panel->done_seq    = next->seq;
+      next               = NULL;
+    }
+  }
+  panel->inflight = next;
+  spin_unlock_irqrestore( &panel->queue_lock, flags );
+
+  wake_up_all( &panel->fence_wq );
+
+  if( lost )
+  {
+    schedule_delayed_work( &panel->retry_work, msecs_to_jiffies( SSH1106_RETRY_MS ) );
+  }
+
+  if( next )
+  {
+    next->start = ktime_get();
+    ETX_SSH1106_FrameStart( next );
+  }
+}
+
+/****************************************************************************
+ * Name: ETX_SSH1106_RunComplete
+ *
+ * Details : spi_message completion handler. Starts the next run of the
+ *           frame or retires the frame after its last run.
+ ****************************************************************************/
+static void ETX_SSH1106_RunComplete( void *context )
+{
+  struct ssh1106_frame *frame = context;
+  struct ssh1106_run   *run   = &frame->run[frame->cur];
+
+  if( run->msg.status )
+  {
+    pr_err("run %u of frame %llu failed (%d)\n", frame->cur, frame->seq, run->msg.status);
+    ETX_SSH1106_FrameDone( frame, true );
+    return;
+  }
+
+  if( ++frame->cur < frame->nr_runs )
+  {
+    ETX_SSH1106_FrameStart( frame );
+  }
+  else
+  {
+    ETX_SSH1106_FrameDone( frame, false );
+  }
+}
+
+/****************************************************************************
+ * Name: ETX_SSH1106_SeqDone
+ *
+ * Details : This function tells if the frame with this fence number is
+ *           already on the panel.
+ ****************************************************************************/
+static bool ETX_SSH1106_SeqDone( struct ssh1106_panel *panel, u64 seq )
+{
+  unsigned long flags;
+  bool          done;
+
+  spin_lock_irqsave( &panel->queue_lock, flags );
+  done = ( panel->done_seq >= seq );
+  spin_unlock_irqrestore( &panel->queue_lock, flags );
+
+  return( done );
+}
+
+/****************************************************************************
+ * Name: ETX_SSH1106_SetCursor
+ *
+ * Details : This function moves the drawing cursor in the shadow buffer.
+ *           Nothing is sent to the Display until ETX_SSH1106_Flush().
+ *
+ * Argument:
+ *              lineNo    -> Line Number
+ *              cursorPos -> Cursor Position
+ * 
+ ****************************************************************************/
+void ETX_SSH1106_SetCursor( struct ssh1106_panel *panel, uint8_t lineNo, uint8_t cursorPos )
+{
+
+  /* Move the Cursor to specified position only if it is in range */
+  if((lineNo <= SSH1106_MAX_LINE) && (cursorPos < SSH1106_MAX_SEG))
+  {
+
+    panel->line_num   = lineNo;                    // Save the specified line number
+    panel->cursor_pos = cursorPos;                 // Save the specified cursor position
+
+  }
+}
+
+/****************************************************************************
+ * Name: ETX_SSH1106_GoToNextLine
+ *
+ * Details : This function is specific to the SSD_1306 OLED and move the cursor 
  *           to the next line.
  ****************************************************************************/
-void ETX_SSH1106_GoToNextLine( void )
+void ETX_SSH1106_GoToNextLine( struct ssh1106_panel *panel )
 {
   /*
   ** Increment the current line number.
   ** roll it back to first line, if it exceeds the limit. 
   */
 
-  SSH1106_LineNum++;
+  panel->line_num++;
 
-  SSH1106_LineNum = (SSH1106_LineNum & SSH1106_MAX_LINE);
+  panel->line_num = (panel->line_num & SSH1106_MAX_LINE);
 
-  ETX_SSH1106_SetCursor(SSH1106_LineNum,0); /* Finally move it to next line */
+  ETX_SSH1106_SetCursor(panel, panel->line_num,0); /* Finally move it to next line */
 
 }
 
@@ -539,7 +1337,7 @@ void ETX_SSH1106_GoToNextLine( void )
  *           c   -> character to be written
  * 
  ****************************************************************************/
-void ETX_SSH1106_PrintChar( unsigned char c )
+void ETX_SSH1106_PrintChar( struct ssh1106_panel *panel, unsigned char c )
 {
   uint8_t data_byte;
   uint8_t temp = 0;
@@ -548,11 +1346,11 @@ void ETX_SSH1106_PrintChar( unsigned char c )
   ** If we character is greater than segment len or we got new line charcter
   ** then move the cursor to the new line
   */ 
-  if( (( SSH1106_CursorPos + SSH1106_FontSize ) >= SSH1106_MAX_SEG ) ||
+  if( (( panel->cursor_pos + panel->font_size ) >= SSH1106_MAX_SEG ) ||
       ( c == '\n' )
   )
   {
-    ETX_SSH1106_GoToNextLine();
+    ETX_SSH1106_GoToNextLine(panel);
   }
   
   // print charcters other than new line
@@ -560,7 +1358,7 @@ void ETX_SSH1106_PrintChar( unsigned char c )
   {
   
     /*
-    ** In our font array (SSH1106_font), space starts in 0th index.
+    ** In our font array (oled_font_5x7_glyphs), space starts in 0th index.
     ** But in ASCII table, Space starts from 32 (0x20).
     ** So we need to match the ASCII table with our font table.
     ** We can subtract 32 (0x20) in order to match with our font table.
@@ -568,17 +1366,96 @@ void ETX_SSH1106_PrintChar( unsigned char c )
     c -= 0x20;  //or c -= ' ';
     do
     {
-      data_byte= SSH1106_font[c][temp];         // Get the data to be displayed from LookUptable
-      ETX_SSH1106_Write(false, data_byte);  // write data to the OLED
-      SSH1106_CursorPos++;
+      data_byte= oled_fonts[OLED_FONT_5X7].glyphs[( c * SSH1106_DEF_FONT_SIZE ) + temp];  // Get the data to be displayed from LookUptable
+      panel->buffer[panel->line_num][panel->cursor_pos] = data_byte;  // render into the shadow buffer
+      panel->cursor_pos++;
       
       temp++;
       
-    } while ( temp < SSH1106_FontSize);
+    } while ( temp < panel->font_size);
     
-    ETX_SSH1106_Write(false, 0x00);         //Display the data
-    SSH1106_CursorPos++;
+    panel->buffer[panel->line_num][panel->cursor_pos] = 0x00;         // spacer column
+    panel->cursor_pos++;
+
+    panel->dirty_pages |= ( 1u << panel->line_num );
+  }
+}
+
+/****************************************************************************
+ * Name: ETX_SSH1106_SegmentLen
+ *
+ * Details : This function returns how many chars of str fit on the current
+ *           line from the cursor, up to the next new line (cacheable part).
+ ****************************************************************************/
+static unsigned int ETX_SSH1106_SegmentLen( struct ssh1106_panel *panel, const char *str )
+{
+  unsigned int pos = panel->cursor_pos;
+  unsigned int len = 0;
+
+  while( str[len] && ( str[len] != '\n' ) && ( len < SSH1106_RCACHE_TEXT ) &&
+         ( ( pos + panel->font_size ) < SSH1106_MAX_SEG ) )
+  {
+    pos += panel->font_size + 1;
+    len++;
+  }
+
+  return( len );
+}
+
+/****************************************************************************
+ * Name: ETX_SSH1106_Segment
+ *
+ * Details : This function draws len chars that fit on the current line,
+ *           from the render cache when they were drawn before, and keeps
+ *           the rendered columns in the cache otherwise.
+ ****************************************************************************/
+static void ETX_SSH1106_Segment( struct ssh1106_panel *panel, const char *str, unsigned int len )
+{
+  struct ssh1106_rcache_entry *e;
+  struct ssh1106_rcache_entry *lru   = &panel->rcache.entry[0];
+  u32                          hash  = jhash( str, len, panel->font_size );
+  uint8_t                      start = panel->cursor_pos;
+  unsigned int                 i;
+
+  for( i = 0; i < SSH1106_RCACHE_ENTRIES; i++ )
+  {
+    e = &panel->rcache.entry[i];
+
+    if( ( e->len == len ) && ( e->hash == hash ) && ( e->font_size == panel->font_size ) &&
+        ( memcmp( e->text, str, len ) == 0 ) )
+    {
+      memcpy( &panel->buffer[panel->line_num][start], e->cols, e->ncols );
+      panel->cursor_pos   += e->ncols;
+      panel->dirty_pages  |= ( 1u << panel->line_num );
+      e->used              = ++panel->rcache.clock;
+      panel->rcache.hits++;
+      return;
+    }
+
+    if( e->used < lru->used )
+    {
+      lru = e;
+    }
+  }
+
+  panel->rcache.misses++;
+
+  for( i = 0; i < len; i++ )
+  {
+    ETX_SSH1106_PrintChar( panel, str[i] );
+  }
+
+  if( lru->len )
+  {
+    panel->rcache.evictions++;
   }
+  memcpy( lru->text, str, len );
+  lru->len       = len;
+  lru->font_size = panel->font_size;
+  lru->ncols     = panel->cursor_pos - start;
+  lru->hash      = hash;
+  lru->used      = ++panel->rcache.clock;
+  memcpy( lru->cols, &panel->buffer[panel->line_num][start], lru->ncols );
 }
 
 /****************************************************************************
@@ -591,11 +1468,96 @@ void ETX_SSH1106_PrintChar( unsigned char c )
  *           str   -> string to be written
  * 
  ****************************************************************************/
-void ETX_SSH1106_String(char *str)
+void ETX_SSH1106_String(struct ssh1106_panel *panel, char *str)
 {
+  unsigned int len;
+
   while( *str )
   {
-    ETX_SSH1106_PrintChar(*str++);
+    len = ETX_SSH1106_SegmentLen(panel, str);
+
+    if( len >= 2 )
+    {
+      ETX_SSH1106_Segment(panel, str, len);
+      str += len;
+    }
+    else
+    {
+      //new line, wrap or lone char
+      ETX_SSH1106_PrintChar(panel, *str++);
+    }
+  }
+}
+
+/****************************************************************************
+ * Name: ETX_SSH1106_StringFont
+ *
+ * Details : This function draws the string with one of the oled_fonts[]
+ *           fonts. Each page of a glyph is copied straight into the shadow
+ *           buffer; glyphs taller than a page cover the pages below the
+ *           cursor line, and a new line moves down by the font height.
+ * 
+ * Arguments:
+ *           str          -> string to be written
+ *           font_id      -> OLED_FONT_5X7, OLED_FONT_8X16, OLED_FONT_12X24
+ *           proportional -> false: fixed cells, true: inked columns + 1
+ * 
+ ****************************************************************************/
+void ETX_SSH1106_StringFont( struct ssh1106_panel *panel, const char *str, unsigned int font_id, bool proportional )
+{
+  const struct oled_font *font;
+  const unsigned char    *glyph;
+  unsigned int            idx;
+  unsigned int            left;
+  unsigned int            width;
+  unsigned int            gap;
+  unsigned int            page;
+
+  if( font_id >= OLED_NR_FONTS )
+  {
+    return;
+  }
+  font = &oled_fonts[font_id];
+
+  for( ; *str; str++ )
+  {
+    idx   = (unsigned char)*str - font->first;
+    if( idx >= font->count )
+    {
+      idx = '?' - font->first;
+    }
+    left  = proportional ? font->left[idx] : 0;
+    width = proportional ? font->ink[idx]  : font->width;
+    gap   = proportional ? 1               : font->spacing;
+
+    //new line, or the glyph doesn't fit on the line
+    if( ( *str == '\n' ) || ( ( panel->cursor_pos + width ) > SSH1106_MAX_SEG ) )
+    {
+      panel->line_num  += font->pages;
+      panel->cursor_pos = 0;
+    }
+    //back to the top once the glyph rows don't fit, a trailing '\n' included
+    if( ( panel->line_num + font->pages ) > SSH1106_MAX_PAGE )
+    {
+      panel->line_num = 0;
+    }
+    if( *str == '\n' )
+    {
+      continue;
+    }
+
+    glyph = font->glyphs + ( idx * font->pages * font->width );
+
+    for( page = 0; page < font->pages; page++ )
+    {
+      memcpy( &panel->buffer[panel->line_num + page][panel->cursor_pos],
+              &glyph[( page * font->width ) + left], width );
+      memset( &panel->buffer[panel->line_num + page][panel->cursor_pos + width], 0x00,
+              min( gap, SSH1106_MAX_SEG - ( panel->cursor_pos + width ) ) );
+    }
+
+    panel->dirty_pages |= ( ( 1u << font->pages ) - 1 ) << panel->line_num;
+    panel->cursor_pos   = min( panel->cursor_pos + width + gap, (unsigned int)SSH1106_MAX_SEG );
   }
 }
 
@@ -610,33 +1572,42 @@ void ETX_SSH1106_String(char *str)
  *                               false - normal display 
  * 
  ****************************************************************************/
-void ETX_SSH1106_InvertDisplay(bool need_to_invert)
+void ETX_SSH1106_InvertDisplay(struct ssh1106_panel *panel, bool need_to_invert)
 {
+  panel->inverted = need_to_invert;
+
+  //not up yet: the bring-up work applies it
+  if( !panel->ready )
+  {
+    return;
+  }
+
+  //the single byte path must not toggle DC under a queued frame
+  ETX_SSH1106_Sync(panel);
+
   if(need_to_invert)
   {
-    ETX_SSH1106_Write(true, 0xA7); // Invert the display
+    ETX_SSH1106_Write(panel, true, 0xA7); // Invert the display
   }
   else
   {
-    ETX_SSH1106_Write(true, 0xA6); // Normal display
+    ETX_SSH1106_Write(panel, true, 0xA6); // Normal display
   }
+
+  ETX_SSH1106_StreamFlush(panel);
 }
 
 /****************************************************************************
  * Name: ETX_SSH1106_fill
  *
- * Details : This function clears the Display
+ * Details : This function fills the whole shadow buffer with the data
  ****************************************************************************/
-static void ETX_SSH1106_fill(unsigned char data)
+static void ETX_SSH1106_fill(struct ssh1106_panel *panel, unsigned char data)
 {
-  unsigned int total  = 128 * 8;  // 8 pages x 128 segments x 8 bits of data
-  unsigned int i      = 0;
-  
-  //Fill the Display
-  for(i = 0; i < total; i++)
-  {
-      ETX_SSH1106_Write(false, data);
-  }
+  //Fill the Display: 8 pages x 132 segments x 8 bits of data
+  memset( panel->buffer, data, SSH1106_FB_SIZE );
+
+  panel->dirty_pages = ( 1u << SSH1106_MAX_PAGE ) - 1;
 }
 
 /****************************************************************************
@@ -644,233 +1615,1662 @@ static void ETX_SSH1106_fill(unsigned char data)
  *
  * Details : This function clears the Display
  ****************************************************************************/
-void ETX_SSH1106_ClearDisplay( void )
+void ETX_SSH1106_ClearDisplay( struct ssh1106_panel *panel )
 {
-  unsigned int i = 0;
-  
-  for (i=0; i<SSH1106_MAX_LINE+1; i++){
-    ETX_SSH1106_SetCursor(i,0);
-    ETX_SSH1106_fill( 0x00 );
-  }
-
+  ETX_SSH1106_fill( panel, 0x00 );
+  ETX_SSH1106_SetCursor(panel, 0,0);
 }
 
 /****************************************************************************
- * Name: ETX_SSH1106_DisplayInit
+ * Name: ETX_SSH1106_DitherRow
  *
- * Details : This function Initializes the Display
+ * Details : This function turns one row of gray pixels into the bits of
+ *           row y of the shadow buffer (the band must be cleared before).
+ *           Threshold and Bayer are branch-free per pixel so the compiler
+ *           can unroll/vectorize them; Floyd-Steinberg carries its error
+ *           along the row and into the next one (panel->fs_err, x16).
+ *
+ * Argument:
+ *              panel -> panel, dither method and error rows
+ *              gray  -> SSH1106_MAX_SEG gray pixels
+ *              y     -> row, 0..63
+ *              reset -> first row of a conversion: no error carried in
+ * 
  ****************************************************************************/
-int ETX_SSH1106_DisplayInit(void)
+static const uint8_t SSH1106_Bayer4[4][4] =
 {
-  int ret = 0;
-
-  //Initialize the Reset and DC GPIOs
-  ret = ETX_SSH1106_ResetDcInit();
+  {   8, 136,  40, 168 },                           // (index * 16) + 8
+  { 200,  72, 232, 104 },
+  {  56, 184,  24, 152 },
+  { 248, 120, 216,  88 },
+};
 
-  if( ret >= 0 )
+static void ETX_SSH1106_DitherRow( struct ssh1106_panel *panel, const uint8_t *gray, unsigned int y, bool reset )
+{
+  uint8_t       *dst   = panel->buffer[y / 8];
+  unsigned int   shift = y % 8;
+  const uint8_t *thr   = SSH1106_Bayer4[y % 4];
+  int16_t       *cur   = panel->fs_err[y % 2];
+  int16_t       *next  = panel->fs_err[( y + 1 ) % 2];
+  unsigned int   x;
+  int            v, e;
+
+  switch( panel->dither )
   {
-    //Make the RESET Line to 0
-    ETX_SSH1106_setRst( 0u );
-    msleep(100);                          // delay
-    //Make the DC Line to 1
-    ETX_SSH1106_setRst( 1u );
-    msleep(100);                          // delay
+    case SSH1106_DITHER_THRESHOLD:
+      for( x = 0; x < SSH1106_MAX_SEG; x++ )
+      {
+        dst[x] |= ( gray[x] >> 7 ) << shift;
+      }
+      break;
 
-#if 1
-    /*
-    ** Commands to initialize the SSD_1106 OLED Display
-    */
-    ETX_SSH1106_Write(true, 0xAE);        // Entire Display OFF
-    ETX_SSH1106_Write(true, 0xD5);        // Set Display Clock Divide Ratio and Oscillator Frequency
-    ETX_SSH1106_Write(true, 0x80);        // Default Setting for Display Clock Divide Ratio and Oscillator Frequency that is recommended
-    ETX_SSH1106_Write(true, 0xA8);        // Set Multiplex Ratio
-    ETX_SSH1106_Write(true, 0x3F);        // 64 COM lines
-    ETX_SSH1106_Write(true, 0xD3);        // Set display offset
-    ETX_SSH1106_Write(true, 0x00);        // 0 offset
-    ETX_SSH1106_Write(true, 0x40);        // Set first line as the start line of the display
-    ETX_SSH1106_Write(true, 0xAD);        // Charge pump
-    ETX_SSH1106_Write(true, 0x8B);        // Enable charge dump during display on
-    ETX_SSH1106_Write(true, 0xA1);        // Set segment remap with column address 127 mapped to segment 0
-    ETX_SSH1106_Write(true, 0xC8);        // Set com output scan direction, scan from com63 to com 0
-    ETX_SSH1106_Write(true, 0xDA);        // Set com pins hardware configuration
-    ETX_SSH1106_Write(true, 0x12);        // Alternative com pin configuration, disable com left/right remap
-    ETX_SSH1106_Write(true, 0x81);        // Set contrast control
-    ETX_SSH1106_Write(true, 0xBF);        // Set Contrast to 128
-    ETX_SSH1106_Write(true, 0xD9);        // Set pre-charge period
-    ETX_SSH1106_Write(true, 0x22);        // Phase 1 period of 15 DCLK, Phase 2 period of 1 DCLK 
-    ETX_SSH1106_Write(true, 0xDB);        // Set Vcomh deselect level
-    ETX_SSH1106_Write(true, 0x40);        // Vcomh deselect level ~ 0.77 Vcc
-    ETX_SSH1106_Write(true, 0x32);        // Set VPP
-    ETX_SSH1106_Write(true, 0xA6);        // Set Display in Normal Mode, 1 = ON, 0 = OFF
-    ETX_SSH1106_Write(true, 0xAF);        // Display ON in normal mode
-    
-#endif
+    case SSH1106_DITHER_BAYER:
+      //( gray + 256 - thr ) >> 8 is 1 when gray >= thr
+      for( x = 0; x < SSH1106_MAX_SEG; x++ )
+      {
+        dst[x] |= ( ( gray[x] + 256 - thr[x % 4] ) >> 8 ) << shift;
+      }
+      break;
 
+    case SSH1106_DITHER_FS:
+      if( reset )
+      {
+        memset( cur, 0, sizeof(panel->fs_err[0]) );
+      }
+      memset( next, 0, sizeof(panel->fs_err[0]) );
+      //pixel x is at index x + 1, so x - 1 and x + 1 never leave the row
+      for( x = 0; x < SSH1106_MAX_SEG; x++ )
+      {
+        v = gray[x] + ( cur[x + 1] / 16 );
+        if( v >= 128 )
+        {
+          dst[x] |= 1u << shift;
+          e = v - 255;
+        }
+        else
+        {
+          e = v;
+        }
+        cur[x + 2]  += e * 7;
+        next[x]     += e * 3;
+        next[x + 1] += e * 5;
+        next[x + 2] += e;
+      }
+      break;
   }
-
-  return( ret );
 }
 
 /****************************************************************************
- * Name: ETX_SSH1106_DisplayDeInit
+ * Name: ETX_SSH1106_ConvertImage
  *
- * Details : This function De-initializes the Display
+ * Details : This function dithers pages first..last of panel->image into
+ *           the shadow buffer, one pass over the rows of those pages.
+ *
+ * Argument:
+ *              panel -> panel, image in panel->format
+ *              first -> first page
+ *              last  -> last page
+ * 
  ****************************************************************************/
-void ETX_SSH1106_DisplayDeInit(void)
+static void ETX_SSH1106_ConvertImage( struct ssh1106_panel *panel, uint8_t first, uint8_t last )
 {
-  ETX_SSH1106_ResetDcDeInit();  //Free the Reset and DC GPIO
+  const uint8_t *gray;
+  const u32     *xrgb;
+  unsigned int   y, x;
+  ktime_t        start = ktime_get();
+
+  memset( panel->buffer[first], 0, ( last - first + 1 ) * SSH1106_MAX_SEG );
+
+  for( y = first * 8; y < ( last + 1 ) * 8; y++ )
+  {
+    if( panel->format == SSH1106_FMT_XRGB8888 )
+    {
+      xrgb = (const u32 *)panel->image + ( y * SSH1106_MAX_SEG );
+      for( x = 0; x < SSH1106_MAX_SEG; x++ )
+      {
+        panel->gray[x] = ( ( 77 * ( ( xrgb[x] >> 16 ) & 0xff ) ) +
+                           ( 150 * ( ( xrgb[x] >> 8 ) & 0xff ) ) +
+                           ( 29 * ( xrgb[x] & 0xff ) ) ) >> 8;
+      }
+      gray = panel->gray;
+    }
+    else
+    {
+      gray = (const uint8_t *)panel->image + ( y * SSH1106_MAX_SEG );
+    }
+
+    ETX_SSH1106_DitherRow( panel, gray, y, ( y == first * 8 ) );
+  }
+
+  panel->convert_ns = ktime_to_ns( ktime_sub( ktime_get(), start ) );
 }
 
 /****************************************************************************
-*   @frk: to develop some funcs based on APIs
-*
-*****************************************************************************/
+ * Name: ETX_SSH1106_Unpack
+ *
+ * Details : This function decodes the PackBits stream of an asset into a
+ *           page-major image at (x, page). Columns and pages outside the
+ *           132x64 RAM are dropped. With pages NULL the stream is only
+ *           checked. Returns 0, or -EINVAL when the stream does not decode
+ *           to exactly width * pages bytes.
+ *
+ * Argument:
+ *              asset -> asset to decode
+ *              pages -> page-major image, SSH1106_MAX_SEG per page, or NULL
+ *              x     -> left column
+ *              page  -> top page
+ * 
+ ****************************************************************************/
+static int ETX_SSH1106_Unpack( const struct oled_asset *asset, uint8_t (*pages)[SSH1106_MAX_SEG],
+                               unsigned int x, unsigned int page )
+{
+  const uint8_t *in   = asset->data;
+  const uint8_t *end  = asset->data + asset->len;
+  unsigned int   size = asset->width * asset->pages;
+  unsigned int   pos  = 0;
+  unsigned int   n, i;
+  unsigned int   col, pg;
+  bool           repeat;
+
+  while( in < end )
+  {
+    n = *in++;
+    if( n == 128 )
+    {
+      continue;                                     // no-op
+    }
+    repeat = ( n > 128 );
+    n      = repeat ? ( 257 - n ) : ( n + 1 );
 
-/* to display some shapes */
-void display_rectangle(int len)
+    if( ( ( end - in ) < ( repeat ? 1 : n ) ) || ( ( size - pos ) < n ) )
+    {
+      return( -EINVAL );
+    }
+
+    for( i = 0; i < n; i++, pos++ )
+    {
+      col = x + ( pos % asset->width );
+      pg  = page + ( pos / asset->width );
+      if( pages && ( col < SSH1106_MAX_SEG ) && ( pg < SSH1106_MAX_PAGE ) )
+      {
+        pages[pg][col] = repeat ? in[0] : in[i];
+      }
+    }
+    in += repeat ? 1 : n;
+  }
+
+  return( ( pos == size ) ? 0 : -EINVAL );
+}
+
+/* loaded asset called name, or NULL; frk_spi_assets_lock held */
+static struct ssh1106_asset *ETX_SSH1106_LoadedAssetLocked( const char *name )
 {
-  int i;
+  struct ssh1106_asset *entry;
 
-  /* set ...*/
-  ETX_SSH1106_SetCursor(0,0);  
-  /* Display "Hallo world" to OLED */
-  ETX_SSH1106_String("**********************\n");
+  lockdep_assert_held( &frk_spi_assets_lock );
 
-  for ( i=1; i<len; i++)
+  list_for_each_entry( entry, &frk_spi_assets, node )
   {
-    ETX_SSH1106_SetCursor(i,0);  
-    /* Display "Hallo world" to OLED */
-    ETX_SSH1106_String("*                    *\n");
+    if( strcmp( entry->name, name ) == 0 )
+    {
+      return( entry );
+    }
   }
 
-  /* set ...*/
-  ETX_SSH1106_SetCursor(len,0);  
-  /* Display "Hallo world" to OLED */
-  ETX_SSH1106_String("**********************\n");
-
+  return( NULL );
 }
 
-/* display frank */
-void display_frank(void)
+/* loaded asset called name, or NULL */
+static struct ssh1106_asset *ETX_SSH1106_LoadedAsset( const char *name )
 {
-  ETX_SSH1106_SetCursor(3,15);
-  ETX_SSH1106_String("BOS/ SW/ Frank\n");
-  //ETX_SSH1106_String("Hallo world!!!!");
-}
+  struct ssh1106_asset *entry;
+
+  mutex_lock( &frk_spi_assets_lock );
+  entry = ETX_SSH1106_LoadedAssetLocked( name );
+  mutex_unlock( &frk_spi_assets_lock );
+
+  return( entry );
+}
+
+/****************************************************************************
+ * Name: ETX_SSH1106_FindAsset
+ *
+ * Details : This function returns the asset called name: a built-in one,
+ *           one loaded before, or one loaded now from the firmware file
+ *           frk_spi/<name>.oled (may sleep). The file is loaded without
+ *           frk_spi_assets_lock held; a racing load of the same name that
+ *           got inserted first wins. Returns an ERR_PTR on error.
+ *
+ * Argument:
+ *              name -> asset name
+ *              dev  -> device the firmware is requested for
+ * 
+ ****************************************************************************/
+static const struct oled_asset *ETX_SSH1106_FindAsset( const char *name, struct device *dev )
+{
+  const struct firmware *fw;
+  struct ssh1106_asset  *entry;
+  struct ssh1106_asset  *found;
+  char                   path[SSH1106_ASSET_NAME + 16];
+  int                    i;
+  int                    ret;
+
+  for( i = 0; i < OLED_NR_ASSETS; i++ )
+  {
+    if( strcmp( oled_assets[i].name, name ) == 0 )
+    {
+      return( &oled_assets[i] );
+    }
+  }
+
+  found = ETX_SSH1106_LoadedAsset( name );
+  if( found )
+  {
+    return( &found->asset );
+  }
+
+  //not loaded yet: the name becomes a file name, keep it plain
+  if( ( strlen( name ) >= SSH1106_ASSET_NAME ) || strpbrk( name, "/." ) )
+  {
+    return( ERR_PTR( -EINVAL ) );
+  }
+
+  snprintf( path, sizeof(path), SSH1106_ASSET_FW, name );
+  ret = request_firmware( &fw, path, dev );
+  if( ret < 0 )
+  {
+    return( ERR_PTR( ret ) );
+  }
+
+  //"OLED", width, pages, PackBits stream
+  if( ( fw->size <= OLED_ASSET_HDR_SIZE ) || ( fw->size > OLED_ASSET_HDR_SIZE + U16_MAX ) ||
+      memcmp( fw->data, OLED_ASSET_MAGIC, 4 ) ||
+      ( fw->data[4] == 0 ) || ( fw->data[4] > SSH1106_MAX_SEG ) ||
+      ( fw->data[5] == 0 ) || ( fw->data[5] > SSH1106_MAX_PAGE ) )
+  {
+    pr_err("%s: not an asset\n", path);
+    entry = ERR_PTR( -EINVAL );
+    goto release;
+  }
+
+  entry = kzalloc( struct_size( entry, data, fw->size - OLED_ASSET_HDR_SIZE ), GFP_KERNEL );
+  if( !entry )
+  {
+    entry = ERR_PTR( -ENOMEM );
+    goto release;
+  }
+  strscpy( entry->name, name, sizeof(entry->name) );
+  memcpy( entry->data, fw->data + OLED_ASSET_HDR_SIZE, fw->size - OLED_ASSET_HDR_SIZE );
+  entry->asset.name  = entry->name;
+  entry->asset.data  = entry->data;
+  entry->asset.len   = fw->size - OLED_ASSET_HDR_SIZE;
+  entry->asset.width = fw->data[4];
+  entry->asset.pages = fw->data[5];
+
+  if( ETX_SSH1106_Unpack( &entry->asset, NULL, 0, 0 ) < 0 )
+  {
+    pr_err("%s: bad PackBits stream\n", path);
+    kfree( entry );
+    entry = ERR_PTR( -EINVAL );
+    goto release;
+  }
+
+  //another writer may have loaded it meanwhile: keep the first one
+  mutex_lock( &frk_spi_assets_lock );
+  found = ETX_SSH1106_LoadedAssetLocked( name );
+  if( found )
+  {
+    kfree( entry );
+    entry = found;
+  }
+  else
+  {
+    list_add_tail( &entry->node, &frk_spi_assets );
+    pr_info("asset %s: %ux%u, %u bytes\n", name, entry->asset.width, entry->asset.pages * 8, entry->asset.len);
+  }
+  mutex_unlock( &frk_spi_assets_lock );
+
+release:
+  release_firmware( fw );
+
+  return( IS_ERR( entry ) ? ERR_CAST( entry ) : &entry->asset );
+}
+
+/****************************************************************************
+ * Name: ETX_SSH1106_DrawAsset
+ *
+ * Details : This function draws the asset called name into the shadow
+ *           buffer and flushes it: the touched pages go out as one frame.
+ *           Takes the panel lock (the firmware load is done before).
+ *
+ * Argument:
+ *              panel -> panel to draw on
+ *              name  -> asset name
+ *              x     -> left column, < 0 centers the asset
+ *              page  -> top page
+ * 
+ ****************************************************************************/
+int ETX_SSH1106_DrawAsset( struct ssh1106_panel *panel, const char *name, int x, uint8_t page )
+{
+  const struct oled_asset *asset;
+  unsigned int             last;
+  int                      ret;
+
+  asset = ETX_SSH1106_FindAsset( name, &panel->spi->dev );
+  if( IS_ERR( asset ) )
+  {
+    return( PTR_ERR( asset ) );
+  }
+
+  if( x < 0 )
+  {
+    x = ( SSH1106_MAX_SEG > asset->width ) ? ( SSH1106_MAX_SEG - asset->width ) / 2 : 0;
+  }
+  if( ( x >= SSH1106_MAX_SEG ) || ( page >= SSH1106_MAX_PAGE ) )
+  {
+    return( -EINVAL );
+  }
+  last = min( page + asset->pages, SSH1106_MAX_PAGE ) - 1;
+
+  mutex_lock( &panel->lock );
+  ret = ETX_SSH1106_Unpack( asset, panel->buffer, x, page );
+  panel->dirty_pages |= GENMASK( last, page );
+  ETX_SSH1106_Flush( panel );
+  mutex_unlock( &panel->lock );
+
+  return( ret );
+}
+
+/****************************************************************************
+ * Name: ETX_SSH1106_FrameCursor
+ *
+ * Details : This function adds the page and column address commands of a
+ *           window to the frame, leaving out the ones that would not change
+ *           the controller address state. Returns the command bytes added.
+ *
+ * Argument:
+ *              frame     -> frame being built
+ *              lineNo    -> Line Number (page)
+ *              cursorPos -> Cursor Position (column)
+ * 
+ ****************************************************************************/
+static unsigned int ETX_SSH1106_FrameCursor( struct ssh1106_frame *frame, uint8_t lineNo, uint8_t cursorPos )
+{
+  struct ssh1106_panel *panel = frame->panel;
+  uint8_t               cmd[3];
+  unsigned int          len = 0;
+
+  if( panel->addr_page != lineNo )
+  {
+    cmd[len++] = 0xB0 | lineNo;                    // set page address
+  }
+  else
+  {
+    panel->page_cmds_avoided++;
+  }
+
+  if( ( panel->addr_col < 0 ) || ( ( panel->addr_col & 0x0F ) != ( cursorPos & 0x0F ) ) )
+  {
+    cmd[len++] = 0x00 | (cursorPos&0x0F);          // column start addr
+  }
+  else
+  {
+    panel->col_cmds_avoided++;
+  }
+
+  if( ( panel->addr_col < 0 ) || ( ( panel->addr_col >> 4 ) != ( cursorPos >> 4 ) ) )
+  {
+    cmd[len++] = 0x10 | ( (cursorPos>>4) + 0x10);  // column end addr
+  }
+  else
+  {
+    panel->col_cmds_avoided++;
+  }
+
+  if( len > 0 )
+  {
+    ETX_SSH1106_FrameAddRun( frame, true, cmd, len );
+  }
+
+  panel->addr_page = lineNo;
+  panel->addr_col  = cursorPos;
+
+  return( len );
+}
+
+/****************************************************************************
+ * Name: ETX_SSH1106_FrameAddPage
+ *
+ * Details : This function adds the changed column windows of one page to
+ *           the frame: a cursor run and a data run per window. Gaps of
+ *           unchanged columns not worth a new window are sent as well.
+ *
+ * Argument:
+ *              frame     -> frame being built
+ *              page      -> page to diff against panel->sent
+ *              full      -> send the whole page without diffing
+ * 
+ ****************************************************************************/
+static void ETX_SSH1106_FrameAddPage( struct ssh1106_frame *frame, uint8_t page, bool full )
+{
+  struct ssh1106_panel *panel = frame->panel;
+  const uint8_t        *now   = panel->buffer[page];
+  const uint8_t        *sent  = panel->sent[page];
+  unsigned int          cost  = panel->three_wire ? SSH1106_WINDOW_COST_3W : SSH1106_WINDOW_COST;
+  unsigned int          seg   = 0;
+  unsigned int          start;
+  unsigned int          end;
+  unsigned int          sent_bytes = 0;
+
+  while( seg < SSH1106_MAX_SEG )
+  {
+    if( !full && ( now[seg] == sent[seg] ) )
+    {
+      seg++;
+      continue;
+    }
+
+    //window starts at the first changed column, ends at the last one
+    //before a gap longer than the cost of a new window
+    start = seg;
+    end   = full ? ( SSH1106_MAX_SEG - 1 ) : seg;
+
+    for( seg = end + 1; seg < SSH1106_MAX_SEG; seg++ )
+    {
+      if( now[seg] != sent[seg] )
+      {
+        end = seg;
+      }
+      else if( ( seg - end ) > cost )
+      {
+        break;
+      }
+    }
+
+    sent_bytes += ETX_SSH1106_FrameCursor( frame, page, start );
+    ETX_SSH1106_FrameAddRun( frame, false, &now[start], end - start + 1 );
+
+    //the column counter moves past the data; past the last column it is not tracked
+    panel->addr_col = ( end + 1 < SSH1106_MAX_SEG ) ? ( end + 1 ) : -1;
+
+    sent_bytes += end - start + 1;
+    seg         = end + 1;
+  }
+
+  if( !full )
+  {
+    panel->delta_saved += ( 3 + SSH1106_MAX_SEG ) - sent_bytes;
+  }
+
+  memcpy( panel->sent[page], now, SSH1106_MAX_SEG );
+}
+
+/****************************************************************************
+ * Name: ETX_SSH1106_Flush
+ *
+ * Details : This function queues the changes of the dirty pages of the
+ *           shadow buffer as one frame and returns without waiting for the
+ *           bus. Only the changed column windows are sent. Before the
+ *           panel is brought up the pages just stay dirty.
+ *           Use ETX_SSH1106_Sync() to wait for the panel.
+ ****************************************************************************/
+void ETX_SSH1106_Flush( struct ssh1106_panel *panel )
+{
+  struct ssh1106_frame *frame;
+  unsigned long         flags;
+  uint8_t               pages = 0;
+  uint8_t               full;
+  uint8_t               page;
+  bool                  start = false;
+  bool                  rebuild = false;
+
+  /* panel not up yet: keep the pages dirty for the bring-up replay */
+  if( !panel->ready )
+  {
+    return;
+  }
+
+  /* pages of failed frames: the panel may hold anything there */
+  spin_lock_irqsave( &panel->queue_lock, flags );
+  panel->full_pages  |= panel->lost_pages;
+  panel->dirty_pages |= panel->lost_pages;
+  panel->lost_pages   = 0;
+  spin_unlock_irqrestore( &panel->queue_lock, flags );
+
+  full = panel->full_pages;
+
+  /* drop the dirty pages that ended up unchanged */
+  for( page = 0; page < SSH1106_MAX_PAGE; page++ )
+  {
+    if( !( panel->dirty_pages & ( 1u << page ) ) )
+    {
+      continue;
+    }
+
+    if( ( full & ( 1u << page ) ) ||
+        ( memcmp( panel->buffer[page], panel->sent[page], SSH1106_MAX_SEG ) != 0 ) )
+    {
+      pages |= ( 1u << page );
+    }
+    else
+    {
+      panel->delta_saved += 3 + SSH1106_MAX_SEG;
+    }
+  }
+
+  panel->dirty_pages = 0;
+
+  if( pages == 0 )
+  {
+    return;
+  }
+
+  /*
+  ** take the queued frame back (not started yet), or the free slot.
+  ** panel->sent already counts the changes of the queued frame, so its
+  ** pages are sent whole in the rebuilt frame.
+  */
+  spin_lock_irqsave( &panel->queue_lock, flags );
+  if( panel->queued )
+  {
+    frame          = panel->queued;
+    panel->queued  = NULL;
+    pages         |= frame->pages;
+    full          |= frame->pages;
+    rebuild        = true;
+  }
+  else
+  {
+    frame = ( panel->inflight == &panel->frames[0] ) ? &panel->frames[1] : &panel->frames[0];
+  }
+  frame->seq = ++panel->submit_seq;
+  spin_unlock_irqrestore( &panel->queue_lock, flags );
+
+  /* the rebuilt frame starts from the address state it started from before */
+  if( rebuild )
+  {
+    panel->addr_page = frame->addr_page;
+    panel->addr_col  = frame->addr_col;
+  }
+  if( READ_ONCE( panel->addr_lost ) )
+  {
+    WRITE_ONCE( panel->addr_lost, false );
+    panel->addr_page = -1;
+    panel->addr_col  = -1;
+  }
+  frame->addr_page = panel->addr_page;
+  frame->addr_col  = panel->addr_col;
+
+  frame->len     = 0;
+  frame->nr_runs = 0;
+  frame->cur     = 0;
+  frame->pages   = pages;
+
+  for( page = 0; page < SSH1106_MAX_PAGE; page++ )
+  {
+    if( pages & ( 1u << page ) )
+    {
+      ETX_SSH1106_FrameAddPage( frame, page, ( full & ( 1u << page ) ) != 0 );
+    }
+  }
+
+  panel->full_pages  &= ~pages;
+  panel->flush_bytes  = frame->len;
+  panel->flush_xfers  = frame->nr_runs;
+
+  spin_lock_irqsave( &panel->queue_lock, flags );
+  if( panel->inflight == NULL )
+  {
+    panel->inflight = frame;
+    start           = true;
+  }
+  else
+  {
+    panel->queued   = frame;
+  }
+  spin_unlock_irqrestore( &panel->queue_lock, flags );
+
+  if( start )
+  {
+    frame->start = ktime_get();
+    ETX_SSH1106_FrameStart( frame );
+  }
+}
+
+/****************************************************************************
+ * Name: ETX_SSH1106_Sync
+ *
+ * Details : This function waits until every frame queued so far is on the
+ *           panel (fence).
+ ****************************************************************************/
+int ETX_SSH1106_Sync( struct ssh1106_panel *panel )
+{
+  unsigned long flags;
+  u64           seq;
+
+  spin_lock_irqsave( &panel->queue_lock, flags );
+  seq = panel->submit_seq;
+  spin_unlock_irqrestore( &panel->queue_lock, flags );
+
+  if( !wait_event_timeout( panel->fence_wq, ETX_SSH1106_SeqDone( panel, seq ), msecs_to_jiffies( 1000 ) ) )
+  {
+    pr_err("timeout waiting for frame %llu\n", seq);
+    return( -ETIMEDOUT );
+  }
+
+  return( 0 );
+}
+
+/*
+** Commands to initialize the SSD_1106 OLED Display
+*/
+static const uint8_t SSH1106_InitCmds[] =
+{
+  0xAE,   // Entire Display OFF
+  0xD5,   // Set Display Clock Divide Ratio and Oscillator Frequency
+  0x80,   // Default Setting for Display Clock Divide Ratio and Oscillator Frequency that is recommended
+  0xA8,   // Set Multiplex Ratio
+  0x3F,   // 64 COM lines
+  0xD3,   // Set display offset
+  0x00,   // 0 offset
+  0x40,   // Set first line as the start line of the display
+  0xAD,   // Charge pump
+  0x8B,   // Enable charge dump during display on
+  0xA1,   // Set segment remap with column address 127 mapped to segment 0
+  0xC8,   // Set com output scan direction, scan from com63 to com 0
+  0xDA,   // Set com pins hardware configuration
+  0x12,   // Alternative com pin configuration, disable com left/right remap
+  0x81,   // Set contrast control
+  0xBF,   // Set Contrast to 128
+  0xD9,   // Set pre-charge period
+  0x22,   // Phase 1 period of 15 DCLK, Phase 2 period of 1 DCLK
+  0xDB,   // Set Vcomh deselect level
+  0x40,   // Vcomh deselect level ~ 0.77 Vcc
+  0x32,   // Set VPP
+  0xA6,   // Set Display in Normal Mode, 1 = ON, 0 = OFF
+  0xAF    // Display ON in normal mode
+};
+
+/****************************************************************************
+ * Name: ETX_SSH1106_WriteCmds
+ *
+ * Details : This function sends a command sequence as one command run
+ ****************************************************************************/
+static int ETX_SSH1106_WriteCmds( struct ssh1106_panel *panel, const uint8_t *cmds, size_t len )
+{
+  size_t i;
+
+  for( i = 0; i < len; i++ )
+  {
+    ETX_SSH1106_Write( panel, true, cmds[i] );
+  }
+
+  return( ETX_SSH1106_StreamFlush(panel) );
+}
+
+/*
+** Reset timing from the SH1106 datasheet: RES low pulse width tRW >= 10us,
+** the internal reset is done tR <= 2us after RES goes high.
+*/
+#define SSH1106_RST_LOW_US      (  10 )
+#define SSH1106_RST_WAIT_US     (   2 )
+
+/****************************************************************************
+ * Name: ETX_SSH1106_DisplayInit
+ *
+ * Details : This function Initializes the Display
+ ****************************************************************************/
+int ETX_SSH1106_DisplayInit(struct ssh1106_panel *panel)
+{
+  int ret = 0;
+
+  //Initialize the Reset and DC GPIOs
+  ret = ETX_SSH1106_ResetDcInit(panel);
+
+  if( ret >= 0 )
+  {
+    //Make the RESET Line to 0
+    ETX_SSH1106_setRst( panel, 0u );
+    usleep_range( SSH1106_RST_LOW_US, 2 * SSH1106_RST_LOW_US );
+    //Make the RESET Line to 1
+    ETX_SSH1106_setRst( panel, 1u );
+    usleep_range( SSH1106_RST_WAIT_US, 2 * SSH1106_RST_WAIT_US );
+
+    //address state unknown after the reset
+    panel->addr_page = -1;
+    panel->addr_col  = -1;
+
+#if 1
+    /* Commands to initialize the SSD_1106 OLED Display, in one command run */
+    ret = ETX_SSH1106_WriteCmds( panel, SSH1106_InitCmds, sizeof(SSH1106_InitCmds) );
+    
+#endif
+
+    if( ret < 0 )
+    {
+      pr_err("init sequence failed (%d)\n", ret);
+      ETX_SSH1106_ResetDcDeInit(panel);  //not brought up: the GPIOs go back
+    }
+  }
+
+  return( ret );
+}
+
+/****************************************************************************
+ * Name: ETX_SSH1106_DisplayDeInit
+ *
+ * Details : This function De-initializes the Display
+ ****************************************************************************/
+void ETX_SSH1106_DisplayDeInit(struct ssh1106_panel *panel)
+{
+  ETX_SSH1106_ResetDcDeInit(panel);  //Free the Reset and DC GPIO
+}
+
+/****************************************************************************
+*   @frk: to develop some funcs based on APIs
+*
+*****************************************************************************/
+
+/* to display some shapes */
+void display_rectangle(struct ssh1106_panel *panel, int len)
+{
+  int i;
+
+  /* set ...*/
+  ETX_SSH1106_SetCursor(panel, 0,0);  
+  /* Display "Hallo world" to OLED */
+  ETX_SSH1106_String(panel, "**********************\n");
+
+  for ( i=1; i<len; i++)
+  {
+    ETX_SSH1106_SetCursor(panel, i,0);  
+    /* Display "Hallo world" to OLED */
+    ETX_SSH1106_String(panel, "*                    *\n");
+  }
+
+  /* set ...*/
+  ETX_SSH1106_SetCursor(panel, len,0);  
+  /* Display "Hallo world" to OLED */
+  ETX_SSH1106_String(panel, "**********************\n");
+
+}
+
+/* display frank */
+void display_frank(struct ssh1106_panel *panel)
+{
+  ETX_SSH1106_SetCursor(panel, 3,15);
+  ETX_SSH1106_String(panel, "BOS/ SW/ Frank\n");
+  //ETX_SSH1106_String("Hallo world!!!!");
+}
 
 /******************************************************************************************************/
-/* module init func */
-static int __init oled_spi_driver_init(void)
+/* Framebuffer device: read/write/mmap of the shadow buffer (8 pages x 132 bytes, page-major) */
+/******************************************************************************************************/
+
+/*
+** Deferred I/O: a store through the mapping faults on the write-protected
+** page, page_mkwrite arms panel->defio_work, and the work flushes all the
+** pages changed since the last flush. Stores within one interval are
+** coalesced into one frame.
+*/
+static unsigned int frk_spi_defio_ms = 50;
+module_param(frk_spi_defio_ms, uint, 0644);
+MODULE_PARM_DESC(frk_spi_defio_ms, "mmap flush interval in ms (default 50)");
+
+/*
+** Stores frames for the animation player (lock held). A write at offset
+** 0 starts a new sequence; only whole frames count.
+*/
+static ssize_t frk_spi_anim_upload(struct ssh1106_panel *panel, const char __user *buf, size_t len, loff_t *off)
 {
-    pr_info("\n@frk: going to init...");
+        ssize_t ret;
+
+        if( !panel->anim.frames )
+        {
+          panel->anim.frames = kvzalloc(SSH1106_ANIM_SIZE, GFP_KERNEL);
+          if( !panel->anim.frames )
+          {
+            return -ENOMEM;
+          }
+        }
+
+        if( *off == 0 )
+        {
+          panel->anim.nr  = 0;
+          panel->anim.cur = 0;
+        }
+
+        ret = simple_write_to_buffer(panel->anim.frames, SSH1106_ANIM_SIZE, off, buf, len);
+        if( ret > 0 )
+        {
+          panel->anim.nr = max_t(unsigned int, panel->anim.nr, *off / SSH1106_FB_SIZE);
+        }
+
+        return ret;
+}
 
-/* sysfs part */
-    /*Allocating Major number*/
-    if((alloc_chrdev_region(&dev, 0, 1, "frk_spi_Dev")) <0){
-            pr_info("Cannot allocate major number\n");
-            return -1;
-    }
-    pr_info("Major = %d Minor = %d \n", MAJOR(dev), MINOR(dev));
- 
-    /*Creating cdev structure*/
-    cdev_init(&frk_spi_cdev,&fops);
- 
-    /*Adding character device to the system*/
-    if((cdev_add(&frk_spi_cdev,dev,1)) < 0){
-        pr_info("Cannot add the device to the system\n");
-        goto r_class;
-    }
- 
-    /*Creating struct class*/
-    if(IS_ERR(dev_class = class_create(THIS_MODULE,"frk_spi_class"))){
-        pr_info("Cannot create the struct class\n");
-        goto r_class;
-    }
- 
-    /*Creating device*/
-    if(IS_ERR(device_create(dev_class,NULL,dev,NULL,"frk_spi_device"))){
-        pr_info("Cannot create the Device 1\n");
-        goto r_device;
-    }
- 
-    /*Creating a directory in /sys/kernel/ */
-    kobj_ref = kobject_create_and_add("frk_spi_sysfs",kernel_kobj);
- 
-    /*Creating sysfs file for frk_spi_value*/
-    if(sysfs_create_file(kobj_ref,&frk_spi_attr.attr)){
-            pr_err("Cannot create sysfs file......\n");
-            goto r_sysfs;
-    }
-    if(sysfs_create_file(kobj_ref,&frk_spi_attr_1.attr)){
-            pr_err("Cannot create sysfs file......\n");
-            goto r_sysfs;
+/*
+** Timer tick: queue the next frame. The work is not queued again while
+** the last one still runs, that tick is counted as skipped.
+*/
+static enum hrtimer_restart frk_spi_anim_timer_fn(struct hrtimer *timer)
+{
+        struct ssh1106_panel *panel = container_of(timer, struct ssh1106_panel, anim.timer);
+
+        if( !READ_ONCE(panel->anim.running) )
+        {
+          return HRTIMER_NORESTART;
+        }
+
+        if( !queue_work(system_highpri_wq, &panel->anim.work) )
+        {
+          atomic_inc(&panel->anim.skipped);
+        }
+
+        hrtimer_forward_now(timer, ns_to_ktime(NSEC_PER_SEC / panel->anim.fps));
+
+        return HRTIMER_RESTART;
+}
+
+/*
+** Shows the next frame: copied into the shadow buffer, the pages that
+** differ are marked dirty and the flush sends their changed windows.
+*/
+static void frk_spi_anim_work_fn(struct work_struct *work)
+{
+        struct ssh1106_panel *panel = container_of(work, struct ssh1106_panel, anim.work);
+        const uint8_t        *frame;
+        uint8_t               i;
+
+        mutex_lock(&panel->lock);
+
+        if( !panel->anim.running || !panel->anim.nr )
+        {
+          goto out;
+        }
+
+        if( panel->anim.cur >= panel->anim.nr )
+        {
+          panel->anim.cur = 0;                          //sequence replaced by a shorter one
+        }
+        frame = panel->anim.frames + ( panel->anim.cur * SSH1106_FB_SIZE );
+
+        for( i = 0; i < SSH1106_MAX_PAGE; i++ )
+        {
+          if( memcmp(panel->buffer[i], frame + ( i * SSH1106_MAX_SEG ), SSH1106_MAX_SEG) != 0 )
+          {
+            memcpy(panel->buffer[i], frame + ( i * SSH1106_MAX_SEG ), SSH1106_MAX_SEG);
+            panel->dirty_pages |= ( 1u << i );
+          }
+        }
+        ETX_SSH1106_Flush(panel);
+        panel->anim.shown++;
+
+        if( ++panel->anim.cur >= panel->anim.nr )
+        {
+          panel->anim.cur = 0;
+          if( !panel->anim.loop )
+          {
+            WRITE_ONCE(panel->anim.running, false);     //the timer stops at its next tick
+          }
+        }
+
+out:
+        mutex_unlock(&panel->lock);
+}
+
+/*
+** Starts the playback from the first frame at fps frames per second
+*/
+static int frk_spi_anim_start(struct ssh1106_panel *panel, unsigned int fps, bool loop)
+{
+        frk_spi_anim_stop(panel);
+
+        mutex_lock(&panel->lock);
+        if( !panel->anim.nr )
+        {
+          mutex_unlock(&panel->lock);
+          return -ENODATA;
+        }
+        panel->anim.fps     = fps;
+        panel->anim.loop    = loop;
+        panel->anim.cur     = 0;
+        panel->anim.shown   = 0;
+        atomic_set(&panel->anim.skipped, 0);
+        WRITE_ONCE(panel->anim.running, true);
+        mutex_unlock(&panel->lock);
+
+        //first frame now, then one per period
+        hrtimer_start(&panel->anim.timer, 0, HRTIMER_MODE_REL);
+
+        return 0;
+}
+
+/*
+** Stops the playback, the frame on the panel stays
+*/
+static void frk_spi_anim_stop(struct ssh1106_panel *panel)
+{
+        WRITE_ONCE(panel->anim.running, false);
+        hrtimer_cancel(&panel->anim.timer);
+        cancel_work_sync(&panel->anim.work);
+}
+
+/*
+** This function will be called when we read the Device file
+*/
+static ssize_t frk_spi_read(struct file *filp, char __user *buf, size_t len, loff_t *off)
+{
+        struct ssh1106_panel *panel = filp->private_data;
+        ssize_t               ret;
+
+        mutex_lock(&panel->lock);
+        switch( panel->format )
+        {
+          case SSH1106_FMT_PAGE:
+            ret = simple_read_from_buffer(buf, len, off, panel->buffer, SSH1106_FB_SIZE);
+            break;
+
+          case SSH1106_FMT_ROW:
+            ETX_SSH1106_PagesToRows(panel->buffer, panel->rows, 0, SSH1106_MAX_PAGE - 1);
+            ret = simple_read_from_buffer(buf, len, off, panel->rows, SSH1106_ROWS_SIZE);
+            break;
+
+          case SSH1106_FMT_ANIM:
+            ret = panel->anim.frames ?
+                  simple_read_from_buffer(buf, len, off, panel->anim.frames, panel->anim.nr * SSH1106_FB_SIZE) : 0;
+            break;
+
+          default:
+            ret = simple_read_from_buffer(buf, len, off, panel->image, SSH1106_FormatSize[panel->format]);
+            break;
+        }
+        mutex_unlock(&panel->lock);
+
+        return ret;
+}
+
+/*
+** This function will be called when we write the Device file.
+** The bytes land in the shadow buffer at *off and the touched pages are
+** queued for the panel. A whole frame of the format always goes to
+** offset 0; a write that doesn't fit in the frame from *off is refused,
+** a short count (or 0) would only make userspace retry it forever.
+*/
+static ssize_t frk_spi_write(struct file *filp, const char __user *buf, size_t len, loff_t *off)
+{
+        struct ssh1106_panel *panel = filp->private_data;
+        loff_t                pos   = *off;
+        ssize_t               ret;
+        unsigned int          size;
+        uint8_t               page;
+        uint8_t               first = 0;
+        uint8_t               last  = 0;
+
+        mutex_lock(&panel->lock);
+
+        size = SSH1106_FormatSize[panel->format];
+        if( len == size )
+        {
+          pos  = 0;
+          *off = 0;
+        }
+        else if( ( pos >= size ) || ( len > size - pos ) )
+        {
+          mutex_unlock(&panel->lock);
+          return -EFBIG;
+        }
+
+        if( panel->format == SSH1106_FMT_ANIM )
+        {
+          /* frames for the player, nothing is drawn */
+          ret = frk_spi_anim_upload(panel, buf, len, off);
+          mutex_unlock(&panel->lock);
+          return ret;
+        }
+
+        switch( panel->format )
+        {
+          case SSH1106_FMT_PAGE:
+            ret = simple_write_to_buffer(panel->buffer, SSH1106_FB_SIZE, off, buf, len);
+            break;
+
+          case SSH1106_FMT_ROW:
+            /* a write may cover part of a band of 8 rows: start from the current image */
+            ETX_SSH1106_PagesToRows(panel->buffer, panel->rows, 0, SSH1106_MAX_PAGE - 1);
+            ret = simple_write_to_buffer(panel->rows, SSH1106_ROWS_SIZE, off, buf, len);
+            break;
+
+          default:
+            ret = simple_write_to_buffer(panel->image, SSH1106_FormatSize[panel->format], off, buf, len);
+            break;
+        }
+
+        if( ret > 0 )
+        {
+          /* pages touched: the formats are 8 equal bands of 8 rows */
+          first = pos / ( size / SSH1106_MAX_PAGE );
+          last  = ( pos + ret - 1 ) / ( size / SSH1106_MAX_PAGE );
+
+          if( panel->format == SSH1106_FMT_ROW )
+          {
+            ETX_SSH1106_RowsToPages(panel->rows, panel->buffer, first, last);
+          }
+          else if( panel->format != SSH1106_FMT_PAGE )
+          {
+            ETX_SSH1106_ConvertImage(panel, first, last);
+          }
+
+          for( page = first; page <= last; page++ )
+          {
+            panel->dirty_pages |= ( 1u << page );
+          }
+          ETX_SSH1106_Flush(panel);
+        }
+
+        mutex_unlock(&panel->lock);
+
+        return ret;
+}
+
+/*
+** Page fault on the mapping: hand out the shadow buffer page. The page
+** gets the file mapping so that page_mkclean() can write-protect it.
+*/
+static vm_fault_t frk_spi_vm_fault(struct vm_fault *vmf)
+{
+        struct ssh1106_panel *panel = vmf->vma->vm_private_data;
+        struct page          *page;
+
+        if( vmf->pgoff != 0 )
+        {
+          return VM_FAULT_SIGBUS;
+        }
+
+        page = virt_to_page(panel->buffer);
+        get_page(page);
+
+        if( vmf->vma->vm_file )
+        {
+          page->mapping = vmf->vma->vm_file->f_mapping;
+        }
+        page->index = vmf->pgoff;
+
+        vmf->page = page;
+        return 0;
+}
+
+/*
+** First store to the clean page since the last flush: arm the flush.
+*/
+static vm_fault_t frk_spi_vm_mkwrite(struct vm_fault *vmf)
+{
+        struct ssh1106_panel *panel = vmf->vma->vm_private_data;
+
+        file_update_time(vmf->vma->vm_file);
+
+        /* keeps the work from cleaning the page before the pte is writable */
+        lock_page(vmf->page);
+
+        /* already armed: the pending flush picks this store up as well */
+        schedule_delayed_work(&panel->defio_work, msecs_to_jiffies(frk_spi_defio_ms));
+
+        return VM_FAULT_LOCKED;
+}
+
+static const struct vm_operations_struct frk_spi_vm_ops = {
+  .fault        = frk_spi_vm_fault,
+  .page_mkwrite = frk_spi_vm_mkwrite,
+};
+
+/*
+** This function will be called when we mmap the Device file
+*/
+static int frk_spi_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+        if( ( vma->vm_pgoff != 0 ) || ( vma_pages(vma) != 1 ) )
+        {
+          return -EINVAL;
+        }
+
+        /* a private mapping would only write to its own copy */
+        if( !( vma->vm_flags & VM_SHARED ) )
+        {
+          return -EINVAL;
+        }
+
+        vma->vm_ops          = &frk_spi_vm_ops;
+        vma->vm_private_data = filp->private_data;
+        vma->vm_flags       |= VM_DONTEXPAND | VM_DONTDUMP;
+
+        return 0;
+}
+
+/*
+** Resend of the pages of lost frames (see ETX_SSH1106_FrameDone)
+*/
+static void frk_spi_retry_work_fn(struct work_struct *work)
+{
+        struct ssh1106_panel *panel = container_of(to_delayed_work(work), struct ssh1106_panel, retry_work);
+
+        mutex_lock(&panel->lock);
+        ETX_SSH1106_Flush(panel);
+        mutex_unlock(&panel->lock);
+}
+
+/*
+** Deferred flush of the stores done through the mapping
+*/
+static void frk_spi_defio_work_fn(struct work_struct *work)
+{
+        struct ssh1106_panel *panel = container_of(to_delayed_work(work), struct ssh1106_panel, defio_work);
+        struct page          *page  = virt_to_page(panel->buffer);
+        uint8_t               i;
+
+        /* write-protect again first, so a store after the compare re-arms us */
+        lock_page(page);
+        page_mkclean(page);
+        unlock_page(page);
+
+        mutex_lock(&panel->lock);
+
+        for( i = 0; i < SSH1106_MAX_PAGE; i++ )
+        {
+          if( memcmp(panel->buffer[i], panel->sent[i], SSH1106_MAX_SEG) != 0 )
+          {
+            panel->dirty_pages |= ( 1u << i );
+          }
+        }
+        ETX_SSH1106_Flush(panel);
+
+        mutex_unlock(&panel->lock);
+}
+
+/*
+** Panel bring-up: reset, init sequence, then replay of everything drawn
+** since the module was loaded (the whole shadow buffer, as the panel RAM
+** is unknown) and of the last invert request.
+*/
+static void frk_spi_bringup_fn(struct work_struct *work)
+{
+        struct ssh1106_panel *panel = container_of(work, struct ssh1106_panel, bringup_work);
+        ktime_t               start = ktime_get();
+
+        if( ETX_SSH1106_DisplayInit(panel) < 0 )
+        {
+          pr_err("panel %d bring-up failed\n", panel->id);
+          return;
+        }
+
+        /* splash: decoded into the shadow buffer, goes out with the first frame below */
+        if( frk_spi_splash && ( ETX_SSH1106_DrawAsset(panel, frk_spi_splash, -1, 0) < 0 ) )
+        {
+          pr_err("panel %d: no splash asset %s\n", panel->id, frk_spi_splash);
+        }
+
+        mutex_lock(&panel->lock);
+
+        panel->ready = true;
+        if( panel->inverted )
+        {
+          ETX_SSH1106_InvertDisplay(panel, true);
+        }
+
+        panel->full_pages  = ( 1u << SSH1106_MAX_PAGE ) - 1;
+        panel->dirty_pages = ( 1u << SSH1106_MAX_PAGE ) - 1;
+        ETX_SSH1106_Flush(panel);
+
+        mutex_unlock(&panel->lock);
+
+        pr_info("panel %d up in %lld us\n", panel->id, ktime_us_delta(ktime_get(), start));
+}
+
+/*
+** debugfs: /sys/kernel/debug/frk_spi/panel<id>/string_cache
+*/
+static int frk_spi_rcache_show(struct seq_file *m, void *v)
+{
+        struct ssh1106_panel *panel = m->private;
+        unsigned int          used  = 0;
+        int                   i;
+
+        mutex_lock(&panel->lock);
+        for( i = 0; i < SSH1106_RCACHE_ENTRIES; i++ )
+        {
+          used += ( panel->rcache.entry[i].len != 0 );
+        }
+        seq_printf(m, "hits: %llu\nmisses: %llu\nevictions: %llu\nentries: %u/%u\n",
+                   panel->rcache.hits, panel->rcache.misses, panel->rcache.evictions,
+                   used, SSH1106_RCACHE_ENTRIES);
+        mutex_unlock(&panel->lock);
+
+        return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(frk_spi_rcache);
+
+/*
+** debugfs: /sys/kernel/debug/frk_spi/transpose_bench
+** Time of a whole frame row-major -> page-major conversion, by the 8x8
+** transpose and by a per-pixel loop (the conversion userspace used to do),
+** and a check that both give the same image.
+*/
+#define FRK_SPI_BENCH_LOOPS     ( 1000 )
+
+static void frk_spi_transpose_naive(uint8_t (*rows)[SSH1106_ROW_BYTES], uint8_t (*pages)[SSH1106_MAX_SEG])
+{
+        unsigned int x, y;
+
+        memset(pages, 0, SSH1106_FB_SIZE);
+        for( y = 0; y < SSH1106_MAX_PAGE * 8; y++ )
+        {
+          for( x = 0; x < SSH1106_MAX_SEG; x++ )
+          {
+            if( rows[y][x / 8] & ( 0x80 >> ( x % 8 ) ) )
+            {
+              pages[y / 8][x] |= 1u << ( y % 8 );
+            }
+          }
+        }
+}
+
+static int frk_spi_bench_show(struct seq_file *m, void *v)
+{
+        uint8_t (*rows)[SSH1106_ROW_BYTES];
+        uint8_t (*fast)[SSH1106_MAX_SEG];
+        uint8_t (*slow)[SSH1106_MAX_SEG];
+        ktime_t   start;
+        s64       fast_ns, slow_ns;
+        int       i;
+
+        rows = kmalloc(SSH1106_ROWS_SIZE + ( 2 * SSH1106_FB_SIZE ), GFP_KERNEL);
+        if( !rows )
+        {
+          return -ENOMEM;
+        }
+        fast = (void *)( (uint8_t *)rows + SSH1106_ROWS_SIZE );
+        slow = (void *)( (uint8_t *)fast + SSH1106_FB_SIZE );
+        get_random_bytes(rows, SSH1106_ROWS_SIZE);
+
+        start = ktime_get();
+        for( i = 0; i < FRK_SPI_BENCH_LOOPS; i++ )
+        {
+          ETX_SSH1106_RowsToPages(rows, fast, 0, SSH1106_MAX_PAGE - 1);
+        }
+        fast_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+        start = ktime_get();
+        for( i = 0; i < FRK_SPI_BENCH_LOOPS; i++ )
+        {
+          frk_spi_transpose_naive(rows, slow);
+        }
+        slow_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+        seq_printf(m, "transpose8x8_ns_per_frame: %lld\nper_pixel_ns_per_frame: %lld\nmatch: %s\n",
+                   fast_ns / FRK_SPI_BENCH_LOOPS, slow_ns / FRK_SPI_BENCH_LOOPS,
+                   memcmp(fast, slow, SSH1106_FB_SIZE) ? "no" : "yes");
+
+        kfree(rows);
+
+        return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(frk_spi_bench);
+
+/******************************************************************************************************/
+/* panel instances */
+
+/*
+** Creates panel <id>: SPI device on its bus/chip-select, buffers, char
+** device and sysfs directory. The init screen is drawn into the shadow
+** buffer and the bring-up work is queued.
+*/
+static int frk_spi_panel_create(int id)
+{
+    struct ssh1106_panel  *panel;
+    struct spi_board_info  info = oled_info;
+    struct spi_master     *master;
+    struct device         *device;
+    char                   name[16];
+    int                    ret;
+
+    panel = kvzalloc(sizeof(*panel), GFP_KERNEL);
+    if( panel == NULL ){
+        return -ENOMEM;
     }
 
-/* */
-    int ret; 
-    struct spi_master* master;
+    panel->id         = id;
+    panel->rst_pin    = frk_spi_rst[id];
+    panel->dc_pin     = frk_spi_dc[id];
+    panel->three_wire = frk_spi_3wire;
+    panel->font_size  = SSH1106_DEF_FONT_SIZE;
+    panel->value      = 1;
+    strscpy(panel->string, "Hallo to sysfs", sizeof(panel->string));
+    panel->full_pages = ( 1u << SSH1106_MAX_PAGE ) - 1;
+    panel->dc_level   = -1;
+    panel->addr_page  = -1;
+    panel->addr_col   = -1;
+    panel->frames[0].panel = panel;
+    panel->frames[1].panel = panel;
+    mutex_init(&panel->lock);
+    spin_lock_init(&panel->queue_lock);
+    init_waitqueue_head(&panel->fence_wq);
+    INIT_WORK(&panel->bringup_work, frk_spi_bringup_fn);
+    INIT_DELAYED_WORK(&panel->defio_work, frk_spi_defio_work_fn);
+    INIT_DELAYED_WORK(&panel->retry_work, frk_spi_retry_work_fn);
+    INIT_WORK(&panel->anim.work, frk_spi_anim_work_fn);
+    hrtimer_init(&panel->anim.timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+    panel->anim.timer.function = frk_spi_anim_timer_fn;
+
+    /* shadow buffer page and DMA-safe buffers of the two frame slots */
+    panel->buffer        = (void *)get_zeroed_page(GFP_KERNEL);
+    panel->frames[0].buf = kmalloc(SSH1106_FRAME_ALLOC, GFP_KERNEL);
+    panel->frames[1].buf = kmalloc(SSH1106_FRAME_ALLOC, GFP_KERNEL);
+    panel->stream.buf    = kmalloc(SSH1106_STREAM_SIZE, GFP_KERNEL);
+    panel->image         = kvzalloc(SSH1106_XRGB_SIZE, GFP_KERNEL);
+    if( ( panel->buffer == NULL ) || ( panel->frames[0].buf == NULL ) || ( panel->frames[1].buf == NULL ) ||
+        ( panel->stream.buf == NULL ) || ( panel->image == NULL ) ){
+        pr_err("\n@frk: Failed to allocate frame buffers.");
+        ret = -ENOMEM;
+        goto r_buf;
+    }
 
     /* get SPI master */
-    master = spi_busnum_to_master(oled_info.bus_num);
+    info.bus_num     = frk_spi_bus[id];
+    info.chip_select = frk_spi_cs[id];
+    master = spi_busnum_to_master(info.bus_num);
     if( !master ){
-        pr_err("\n@frk: Failed to get SPI master!!!");
-        return -ENODEV;
+        pr_err("\n@frk: Failed to get SPI master %d!!!", info.bus_num);
+        ret = -ENODEV;
+        goto r_buf;
     }
 
     /* */
-    oled_spi_device = spi_new_device(master, &oled_info);
-    if( oled_spi_device == NULL){
+    panel->spi = spi_new_device(master, &info);
+    spi_master_put(master);
+    if( panel->spi == NULL){
         pr_err("\n@frk: Failed to create spi device.");
-        return -ENODEV;
+        ret = -ENODEV;
+        goto r_buf;
     }
 
     /* */
-    oled_spi_device->bits_per_word = 8;
+    panel->spi->bits_per_word = panel->three_wire ? 9 : 8;
 
     /* setup SPI slave device */
-    ret = spi_setup(oled_spi_device);
+    ret = spi_setup(panel->spi);
+    if(ret && panel->three_wire){
+        pr_warn("\n@frk: 9-bit words not supported, falling back to 4-wire.");
+        panel->three_wire         = false;
+        panel->spi->bits_per_word = 8;
+        ret = spi_setup(panel->spi);
+    }
     if(ret){
         pr_err("\n@frk: Failed to setup slave.");
-        spi_unregister_device(oled_spi_device);
-        return -ENODEV;
+        ret = -ENODEV;
+        goto r_spi;
+    }
+
+    /*Adding character device to the system*/
+    cdev_init(&panel->cdev,&fops);
+    panel->cdev.owner = THIS_MODULE;
+    ret = cdev_add(&panel->cdev, MKDEV(MAJOR(dev), id), 1);
+    if( ret < 0 ){
+        pr_info("Cannot add the device to the system\n");
+        goto r_spi;
+    }
+
+    /*Creating device*/
+    device = device_create(dev_class, NULL, MKDEV(MAJOR(dev), id), panel, "frk_spi_device%d", id);
+    if(IS_ERR(device)){
+        pr_info("Cannot create the Device %d\n", id);
+        ret = PTR_ERR(device);
+        goto r_cdev;
+    }
+
+    /*Creating a directory in /sys/kernel/frk_spi_sysfs */
+    snprintf(name, sizeof(name), "panel%d", id);
+    panel->kobj = kobject_create_and_add(name, kobj_ref);
+    if( panel->kobj == NULL ){
+        ret = -ENOMEM;
+        goto r_device;
+    }
+
+    SSH1106_Panels[id] = panel;
+
+    /*Creating sysfs files*/
+    if( sysfs_create_file(panel->kobj,&frk_spi_attr.attr) ||
+        sysfs_create_file(panel->kobj,&frk_spi_attr_1.attr) ||
+        sysfs_create_file(panel->kobj,&frk_spi_attr_timing.attr) ||
+        sysfs_create_file(panel->kobj,&frk_spi_attr_format.attr) ||
+        sysfs_create_file(panel->kobj,&frk_spi_attr_dither.attr) ||
+        sysfs_create_file(panel->kobj,&frk_spi_attr_asset.attr) ||
+        sysfs_create_file(panel->kobj,&frk_spi_attr_anim.attr) ||
+        sysfs_create_file(panel->kobj,&frk_spi_attr_font.attr) ){
+            pr_err("Cannot create sysfs file......\n");
+            ret = -ENOMEM;
+            goto r_sysfs;
     }
 
+    /*debugfs statistics, optional*/
+    panel->debugfs = debugfs_create_dir(name, frk_spi_debugfs);
+    debugfs_create_file("string_cache", 0444, panel->debugfs, panel, &frk_spi_rcache_fops);
+
 /* SSH1106 APIs here */
 
 #if 1
     pr_info("\n@FRK: going to display DATA by OLED APIs.");    
 
-    /* init  */
-    ETX_SSH1106_DisplayInit();
+    /* init: reset and init sequence run from a work item, insmod does not wait */
+    schedule_work(&panel->bringup_work);
 #endif
 
 #if 1
+    /* drawn into the shadow buffer now, sent once the panel is up */
+    mutex_lock(&panel->lock);
+
     // Clear the display
-    ETX_SSH1106_ClearDisplay();
+    ETX_SSH1106_ClearDisplay(panel);
+
+    /* the splash asset, if any, is drawn by the bring-up */
+    if( !frk_spi_splash )
+    {
+      /* display rectangle */
+      display_rectangle(panel, 7);       
+
+      /* display Frank*/
+      display_frank(panel);
+    }
 
-    /* display rectangle */
-    display_rectangle(7);       
+    /* push the shadow buffer to the panel */
+    ETX_SSH1106_Flush(panel);
 
-    /* display Frank*/
-    display_frank();
+    mutex_unlock(&panel->lock);
 #endif
 
+    return 0;
+
+/* exception */
+r_sysfs:
+    SSH1106_Panels[id] = NULL;
+    kobject_put(panel->kobj);
+
+r_device:
+    device_destroy(dev_class, MKDEV(MAJOR(dev), id));
+
+r_cdev:
+    cdev_del(&panel->cdev);
+
+r_spi:
+    spi_unregister_device(panel->spi);
+
+r_buf:
+    free_page((unsigned long)panel->buffer);
+    kfree(panel->stream.buf);
+    kfree(panel->frames[0].buf);
+    kfree(panel->frames[1].buf);
+    kvfree(panel->image);
+    kvfree(panel->anim.frames);
+    kvfree(panel);
+    return ret;
+}
+
+/*
+** Clears and releases panel <id>
+*/
+static void frk_spi_panel_destroy(struct ssh1106_panel *panel)
+{
+    bool busy = false;                                 // clear frame timed out
+
+/* sysfs */
+    sysfs_remove_file(panel->kobj, &frk_spi_attr.attr);
+    sysfs_remove_file(panel->kobj, &frk_spi_attr_1.attr);
+    sysfs_remove_file(panel->kobj, &frk_spi_attr_timing.attr);
+    sysfs_remove_file(panel->kobj, &frk_spi_attr_format.attr);
+    sysfs_remove_file(panel->kobj, &frk_spi_attr_dither.attr);
+    sysfs_remove_file(panel->kobj, &frk_spi_attr_asset.attr);
+    sysfs_remove_file(panel->kobj, &frk_spi_attr_anim.attr);
+    sysfs_remove_file(panel->kobj, &frk_spi_attr_font.attr);
+    kobject_put(panel->kobj);
+    debugfs_remove_recursive(panel->debugfs);
+    device_destroy(dev_class, MKDEV(MAJOR(dev), panel->id));
+    cdev_del(&panel->cdev);
+
+/* SSH1106 APIs here */
+    frk_spi_anim_stop(panel);
+    cancel_work_sync(&panel->bringup_work);
+    cancel_delayed_work_sync(&panel->defio_work);
+
+    /* not brought up (or failed): the GPIOs are not ours */
+    if( panel->ready )
+    {
+      /* Clear the display, the last frame: a lost one is not resent */
+      pr_info("\n#FRK: going to clean screen by OLED API.");
+      mutex_lock(&panel->lock);
+      ETX_SSH1106_ClearDisplay(panel);                 // Clear Display
+      ETX_SSH1106_Flush(panel);
+      panel->ready = false;
+      mutex_unlock(&panel->lock);
+
+      //wait for the clear frame before the reset
+      busy = ( ETX_SSH1106_Sync(panel) < 0 );
+
+      pr_info("\n@FRK: going to reset OLED.");   
+      ETX_SSH1106_setRst( panel, 0u );
+      if( !busy )
+      {
+        ETX_SSH1106_DisplayDeInit(panel);              // Deinit the SSH1106
+      }
+    }
+    /* the frames are done: no lost frame can queue a resend any more */
+    cancel_delayed_work_sync(&panel->retry_work);
+
+    SSH1106_Panels[panel->id] = NULL;
+
+    /* a frame still on the bus uses the device, the GPIOs, its buffer and the panel */
+    if( busy )
+    {
+      pr_err("panel %d: frame still queued, leaking it\n", panel->id);
+      return;
+    }
+
+/* unregister the device from kernel */ 
+    spi_unregister_device(panel->spi);
+
+    kfree(panel->frames[0].buf);
+    kfree(panel->frames[1].buf);
+    kfree(panel->stream.buf);
+    kvfree(panel->image);
+    kvfree(panel->anim.frames);
+
+    virt_to_page(panel->buffer)->mapping = NULL;
+    free_page((unsigned long)panel->buffer);
+
+    kvfree(panel);
+}
+
+/*
+** Frees the assets loaded from firmware, once the panels are gone
+*/
+static void frk_spi_assets_free(void)
+{
+    struct ssh1106_asset *entry, *tmp;
+
+    list_for_each_entry_safe(entry, tmp, &frk_spi_assets, node)
+    {
+        list_del(&entry->node);
+        kfree(entry);
+    }
+}
+
+/******************************************************************************************************/
+/* module init func */
+static int __init oled_spi_driver_init(void)
+{
+    int i;
+    int ret;
+
+    pr_info("\n@frk: going to init...");
+
+    /* no default GPIOs for the extra panels: pin 0 is somebody else's */
+    if( ( frk_spi_nr_rst != frk_spi_nr_panels ) || ( frk_spi_nr_dc != frk_spi_nr_panels ) )
+    {
+        pr_err("%d panels need %d frk_spi_rst and frk_spi_dc entries (got %d and %d)\n",
+               frk_spi_nr_panels, frk_spi_nr_panels, frk_spi_nr_rst, frk_spi_nr_dc);
+        return -EINVAL;
+    }
+
+/* sysfs part */
+    /*Allocating Major number, one minor per panel*/
+    if((alloc_chrdev_region(&dev, 0, frk_spi_nr_panels, "frk_spi_Dev")) <0){
+            pr_info("Cannot allocate major number\n");
+            return -1;
+    }
+    pr_info("Major = %d Minor = %d \n", MAJOR(dev), MINOR(dev));
+ 
+    /*Creating struct class*/
+    if(IS_ERR(dev_class = class_create(THIS_MODULE,"frk_spi_class"))){
+        pr_info("Cannot create the struct class\n");
+        goto r_class;
+    }
+ 
+    /*Creating a directory in /sys/kernel/ */
+    kobj_ref = kobject_create_and_add("frk_spi_sysfs",kernel_kobj);
+    if( kobj_ref == NULL ){
+        pr_err("Cannot create sysfs directory......\n");
+        goto r_device;
+    }
+
+    frk_spi_debugfs = debugfs_create_dir("frk_spi", NULL);
+    debugfs_create_file("transpose_bench", 0444, frk_spi_debugfs, NULL, &frk_spi_bench_fops);
+
+/* panels */
+    for( i = 0; i < frk_spi_nr_panels; i++ )
+    {
+        ret = frk_spi_panel_create(i);
+        if( ret ){
+            pr_err("\n@frk: panel %d (bus %d, CS%d) failed (%d).", i, frk_spi_bus[i], frk_spi_cs[i], ret);
+            goto r_panels;
+        }
+    }
+
 /* return success */
     pr_info("\n @frk: SPI-oled insert ... DONE!!! \n");
     return 0;
 
 /* exception */
-r_sysfs:
+r_panels:
+        while( i-- > 0 )
+        {
+          frk_spi_panel_destroy(SSH1106_Panels[i]);
+        }
+        frk_spi_assets_free();
+        debugfs_remove_recursive(frk_spi_debugfs);
         kobject_put(kobj_ref); 
-        sysfs_remove_file(kernel_kobj, &frk_spi_attr.attr);
-        sysfs_remove_file(kernel_kobj, &frk_spi_attr_1.attr);
  
 r_device:
         class_destroy(dev_class);
 
 r_class:
-        unregister_chrdev_region(dev,1);
-        cdev_del(&frk_spi_cdev);
+        unregister_chrdev_region(dev,frk_spi_nr_panels);
         return -1;
 
 }
@@ -878,29 +3278,24 @@ r_class:
 /* module exit func*/
 static void __exit oled_spi_driver_exit(void)
 {
+    int i;
+
     pr_info("\n@frk: going to remove...");
 
+/* panels */
+    for( i = frk_spi_nr_panels - 1; i >= 0; i-- )
+    {
+        frk_spi_panel_destroy(SSH1106_Panels[i]);
+    }
+
+/* assets loaded from firmware */
+    frk_spi_assets_free();
+
 /* sysfs */
+    debugfs_remove_recursive(frk_spi_debugfs);
     kobject_put(kobj_ref); 
-    sysfs_remove_file(kernel_kobj, &frk_spi_attr.attr);
-    sysfs_remove_file(kernel_kobj, &frk_spi_attr_1.attr);
-    device_destroy(dev_class,dev);
     class_destroy(dev_class);
-    cdev_del(&frk_spi_cdev);
-    unregister_chrdev_region(dev, 1);
-
-/* SSH1106 APIs here */
-    pr_info("\n@FRK: going to reset OLED.");   
-    ETX_SSH1106_setRst( 0u );
-
-    /* Clear the display */
-    pr_info("\n#FRK: going to clean screen by OLED API.");
-    msleep(1000);
-    ETX_SSH1106_ClearDisplay();                 // Clear Display
-    ETX_SSH1106_DisplayDeInit();                // Deinit the SSH1106
-
-/* unregister the device from kernel */ 
-    spi_unregister_device(oled_spi_device);
+    unregister_chrdev_region(dev, frk_spi_nr_panels);
 
 /* return success */
     pr_info("\n @frk: SPI-oled remove ... DONE!!! \n");
@@ -0,0 +1,671 @@
+/***************************************************************************************************//**
+*  \file       oled_spi_emu.c
+*
+*  \details    Virtual SPI controller with an emulated SH1106/SSD1315 behind it (benchmarking without a panel)
+*
+*  \author     Frank
+*
+*  \board      Linux raspberrypi 5.15.91-v8+
+*
+*  The module registers an SPI controller on bus emu_bus and a 2 line gpio
+*  chip (line 0 = RST, line 1 = DC) standing in for the Pi header. Load it
+*  first, then point the OLED driver at it, e.g.
+*
+*    insmod oled_spi_emu.ko emu_bus=5 emu_gpio_base=500
+*    insmod oled_spi_driver_3.ko frk_spi_bus=5 frk_spi_rst=500 frk_spi_dc=501
+*
+*  Every transfer is decoded with the DC level of the moment (or bit 8 of
+*  the 9-bit words in 3-wire mode) as the selected controller does it:
+*  SH1106 page addressing over 132 columns, or SSD1315 horizontal /
+*  vertical / page addressing over 128 columns.
+*
+*  /sys/kernel/debug/oled_spi_emu/fb      GDDRAM image, 8 pages x 132 (SH1106) or 128 bytes
+*  /sys/kernel/debug/oled_spi_emu/stats   totals and controller state
+*  /sys/kernel/debug/oled_spi_emu/timing  the last OLED_EMU_NR_RECORDS messages
+*  /sys/kernel/debug/oled_spi_emu/reset   write anything to zero the counters
+*
+******************************************************************************************************/
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/device.h>
+#include <linux/delay.h>
+#include <linux/err.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/platform_device.h>
+#include <linux/spi/spi.h>
+#include <linux/gpio/driver.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/math64.h>
+#include <linux/ktime.h>
+
+/* print */
+#undef pr_fmt
+#define pr_fmt(fmt) "@frk-spi_emu: [%s] :" fmt,__func__
+
+#define OLED_EMU_MAX_SEG        ( 132 )           // SH1106 RAM width, the SSD1315 uses 128
+#define OLED_EMU_MAX_PAGE       (   8 )
+#define OLED_EMU_NR_RECORDS     (  64 )           // messages kept for debugfs/timing
+
+#define OLED_EMU_GPIO_RST       (   0 )
+#define OLED_EMU_GPIO_DC        (   1 )
+
+static int emu_bus = 5;
+module_param(emu_bus, int, 0444);
+MODULE_PARM_DESC(emu_bus, "SPI bus number of the virtual controller (default 5)");
+
+static int emu_gpio_base = -1;
+module_param(emu_gpio_base, int, 0444);
+MODULE_PARM_DESC(emu_gpio_base, "First GPIO number of the RST/DC lines (default dynamic, see dmesg)");
+
+static unsigned int emu_max_speed_hz = 10000000;
+module_param(emu_max_speed_hz, uint, 0444);
+MODULE_PARM_DESC(emu_max_speed_hz, "Simulated max_speed_hz of the controller (default 10 MHz)");
+
+static bool emu_ssd1315;
+module_param(emu_ssd1315, bool, 0444);
+MODULE_PARM_DESC(emu_ssd1315, "Emulate an SSD1315 instead of an SH1106 (default off)");
+
+static bool emu_realtime;
+module_param(emu_realtime, bool, 0644);
+MODULE_PARM_DESC(emu_realtime, "Sleep for the simulated bus time of each message (default off)");
+
+/* one SPI message as seen on the wire */
+struct oled_emu_record
+{
+  ktime_t       at;                               // when the message was started
+  unsigned int  bytes;                            // bytes (words in 3-wire mode)
+  unsigned int  xfers;
+  unsigned int  dc_edges;                         // DC changes before/inside the message
+  u32           bus_ns;                           // simulated time at the transfer speeds
+};
+
+/*
+** Controller state, as far as it changes what the GDDRAM receives. Both
+** controllers share the decoder: the SH1106 only knows page addressing,
+** so its 0x20/0x21/0x22 (which it does not have) are decoded as the
+** single byte commands they are on that part.
+*/
+struct oled_emu_state
+{
+  uint8_t   ram[OLED_EMU_MAX_PAGE][OLED_EMU_MAX_SEG];
+  uint8_t   width;                                // 132 or 128
+
+  uint8_t   mode;                                 // 0 horizontal, 1 vertical, 2 page
+  uint8_t   col_start, col_end;
+  uint8_t   page_start, page_end;
+  uint8_t   col, page;
+
+  uint8_t   cmd[8];
+  uint8_t   cmd_len;
+  uint8_t   cmd_need;
+
+  bool      display_on;
+  bool      inverted;
+  uint8_t   contrast;
+
+  int       dc;                                   // DC line level
+  int       rst;                                  // RST line level
+
+  /* statistics */
+  u64       msgs;
+  u64       xfers;
+  u64       bytes;
+  u64       data_bytes;
+  u64       cmd_bytes;
+  u64       bus_ns;
+  u32       max_msg_ns;
+  u64       dc_edges;
+  u64       resets;
+
+  unsigned int dc_edges_msg;                      // DC changes since the last message
+  struct oled_emu_record rec[OLED_EMU_NR_RECORDS];
+  unsigned int rec_head;
+};
+
+static struct oled_emu_state emu;
+static DEFINE_SPINLOCK(emu_lock);
+
+static struct platform_device *emu_pdev;
+static struct spi_controller  *emu_ctlr;
+static struct gpio_chip        emu_gpio;
+static struct dentry          *emu_debugfs;
+
+/******************************************************************************************************/
+/* SH1106 / SSD1315 decoder */
+
+static uint8_t OledEmu_CmdLength(const struct oled_emu_state *s, uint8_t op)
+{
+  switch( op )
+  {
+    case 0x81: case 0xA8: case 0xAD: case 0xD3: case 0xD5:
+    case 0xD9: case 0xDA: case 0xDB:
+      return 2;
+
+    case 0x20: case 0x8D:
+      return emu_ssd1315 ? 2 : 1;
+
+    case 0x21: case 0x22: case 0xA3:
+      return emu_ssd1315 ? 3 : 1;
+
+    case 0x29: case 0x2A:
+      return emu_ssd1315 ? 6 : 1;
+
+    case 0x26: case 0x27: case 0x2C: case 0x2D:
+      return emu_ssd1315 ? 7 : 1;
+
+    default:
+      return 1;
+  }
+}
+
+static void OledEmu_Command(struct oled_emu_state *s)
+{
+  uint8_t *c = s->cmd;
+
+  if( emu_ssd1315 )
+  {
+    switch( c[0] )
+    {
+      case 0x20:
+        s->mode = c[1] & 0x03;
+        return;
+
+      case 0x21:
+        s->col_start = c[1] & 0x7F;
+        s->col_end   = c[2] & 0x7F;
+        s->col       = s->col_start;
+        return;
+
+      case 0x22:
+        s->page_start = c[1] & 0x07;
+        s->page_end   = c[2] & 0x07;
+        s->page       = s->page_start;
+        return;
+
+      default:
+        break;
+    }
+  }
+
+  switch( c[0] )
+  {
+    case 0x81: s->contrast   = c[1];  break;
+    case 0xA6: s->inverted   = false; break;
+    case 0xA7: s->inverted   = true;  break;
+    case 0xAE: s->display_on = false; break;
+    case 0xAF: s->display_on = true;  break;
+
+    default:
+      if( ( c[0] >= 0xB0 ) && ( c[0] <= 0xB7 ) )
+      {
+        s->page = c[0] & 0x07;
+      }
+      else if( c[0] <= 0x0F )
+      {
+        s->col = ( s->col & 0xF0 ) | c[0];
+      }
+      else if( ( c[0] >= 0x10 ) && ( c[0] <= 0x1F ) )
+      {
+        s->col = ( s->col & 0x0F ) | ( ( c[0] & 0x0F ) << 4 );
+      }
+      break;
+  }
+}
+
+static void OledEmu_CmdByte(struct oled_emu_state *s, uint8_t b)
+{
+  s->cmd_bytes++;
+
+  if( s->cmd_len == 0 )
+  {
+    s->cmd_need = OledEmu_CmdLength(s, b);
+  }
+  s->cmd[s->cmd_len++] = b;
+
+  if( s->cmd_len == s->cmd_need )
+  {
+    OledEmu_Command(s);
+    s->cmd_len = 0;
+  }
+}
+
+static void OledEmu_DataByte(struct oled_emu_state *s, uint8_t b)
+{
+  s->data_bytes++;
+  if( s->col < s->width )
+  {
+    s->ram[s->page & 0x07][s->col] = b;
+  }
+
+  switch( s->mode )
+  {
+    case 0:                                       // horizontal (SSD1315)
+      if( s->col++ >= s->col_end )
+      {
+        s->col = s->col_start;
+        if( s->page++ >= s->page_end )
+        {
+          s->page = s->page_start;
+        }
+      }
+      break;
+
+    case 1:                                       // vertical (SSD1315)
+      if( s->page++ >= s->page_end )
+      {
+        s->page = s->page_start;
+        if( s->col++ >= s->col_end )
+        {
+          s->col = s->col_start;
+        }
+      }
+      break;
+
+    default:                                      // page: wraps in the page
+      s->col = ( s->col + 1 ) % s->width;
+      break;
+  }
+}
+
+/* power-on state */
+static void OledEmu_Reset(struct oled_emu_state *s)
+{
+  s->width      = emu_ssd1315 ? 128 : OLED_EMU_MAX_SEG;
+  s->mode       = 2;
+  s->col_start  = 0;
+  s->col_end    = s->width - 1;
+  s->page_start = 0;
+  s->page_end   = OLED_EMU_MAX_PAGE - 1;
+  s->col        = 0;
+  s->page       = 0;
+  s->cmd_len    = 0;
+  s->display_on = false;
+  s->inverted   = false;
+  s->contrast   = emu_ssd1315 ? 0x7F : 0x80;
+}
+
+/******************************************************************************************************/
+/* RST/DC gpio chip */
+
+static int oled_emu_gpio_get(struct gpio_chip *gc, unsigned int offset)
+{
+  return ( offset == OLED_EMU_GPIO_DC ) ? READ_ONCE(emu.dc) : READ_ONCE(emu.rst);
+}
+
+static void oled_emu_gpio_set(struct gpio_chip *gc, unsigned int offset, int value)
+{
+  unsigned long flags;
+
+  value = !!value;
+
+  spin_lock_irqsave(&emu_lock, flags);
+
+  if( offset == OLED_EMU_GPIO_DC )
+  {
+    if( emu.dc != value )
+    {
+      emu.dc_edges++;
+      emu.dc_edges_msg++;
+    }
+    emu.dc = value;
+  }
+  else
+  {
+    /* the controller is held in reset while RST is low */
+    if( !value )
+    {
+      if( emu.rst )
+      {
+        emu.resets++;
+      }
+      OledEmu_Reset(&emu);
+    }
+    emu.rst = value;
+  }
+
+  spin_unlock_irqrestore(&emu_lock, flags);
+}
+
+static int oled_emu_gpio_direction_output(struct gpio_chip *gc, unsigned int offset, int value)
+{
+  oled_emu_gpio_set(gc, offset, value);
+  return 0;
+}
+
+static int oled_emu_gpio_get_direction(struct gpio_chip *gc, unsigned int offset)
+{
+  return GPIO_LINE_DIRECTION_OUT;
+}
+
+static const char * const oled_emu_gpio_names[] = { "OLED_RST", "OLED_DC" };
+
+/******************************************************************************************************/
+/* SPI controller */
+
+static int oled_emu_transfer_one_message(struct spi_controller *ctlr, struct spi_message *msg)
+{
+  struct oled_emu_record *rec;
+  struct spi_transfer    *xfer;
+  unsigned long           flags;
+  unsigned int            i, words;
+  u32                     speed;
+  u64                     ns = 0;
+
+  spin_lock_irqsave(&emu_lock, flags);
+
+  rec = &emu.rec[emu.rec_head];
+  emu.rec_head = ( emu.rec_head + 1 ) % OLED_EMU_NR_RECORDS;
+
+  rec->at       = ktime_get();
+  rec->bytes    = 0;
+  rec->xfers    = 0;
+  rec->dc_edges = emu.dc_edges_msg;
+  emu.dc_edges_msg = 0;
+
+  list_for_each_entry(xfer, &msg->transfers, transfer_list)
+  {
+    speed = xfer->speed_hz ? min(xfer->speed_hz, emu_max_speed_hz) : emu_max_speed_hz;
+
+    if( xfer->bits_per_word == 9 )
+    {
+      const u16 *w = xfer->tx_buf;
+
+      words = xfer->len / 2;
+      for( i = 0; w && ( i < words ); i++ )
+      {
+        if( w[i] & 0x100 ) OledEmu_DataByte(&emu, w[i] & 0xFF); else OledEmu_CmdByte(&emu, w[i] & 0xFF);
+      }
+    }
+    else
+    {
+      const u8 *b = xfer->tx_buf;
+
+      words = xfer->len;
+      for( i = 0; b && ( i < words ); i++ )
+      {
+        if( emu.dc ) OledEmu_DataByte(&emu, b[i]); else OledEmu_CmdByte(&emu, b[i]);
+      }
+    }
+
+    ns += div_u64((u64)words * ( xfer->bits_per_word ? xfer->bits_per_word : 8 ) * NSEC_PER_SEC, speed);
+
+    rec->bytes += words;
+    rec->xfers++;
+    msg->actual_length += xfer->len;
+  }
+
+  rec->bus_ns = (u32)min_t(u64, ns, U32_MAX);
+
+  emu.msgs++;
+  emu.xfers  += rec->xfers;
+  emu.bytes  += rec->bytes;
+  emu.bus_ns += ns;
+  if( rec->bus_ns > emu.max_msg_ns )
+  {
+    emu.max_msg_ns = rec->bus_ns;
+  }
+
+  spin_unlock_irqrestore(&emu_lock, flags);
+
+  if( emu_realtime && ( ns >= NSEC_PER_USEC ) )
+  {
+    u64 us = div_u64(ns, NSEC_PER_USEC);
+
+    usleep_range(us, us + ( us >> 3 ) + 1);
+  }
+
+  msg->status = 0;
+  spi_finalize_current_message(ctlr);
+
+  return 0;
+}
+
+/******************************************************************************************************/
+/* debugfs */
+
+static ssize_t oled_emu_fb_read(struct file *filp, char __user *buf, size_t len, loff_t *off)
+{
+  unsigned long flags;
+  unsigned int  width = emu.width;
+  uint8_t      *fb;
+  unsigned int  p;
+  ssize_t       ret;
+
+  fb = kmalloc(OLED_EMU_MAX_PAGE * OLED_EMU_MAX_SEG, GFP_KERNEL);
+  if( !fb )
+  {
+    return -ENOMEM;
+  }
+
+  spin_lock_irqsave(&emu_lock, flags);
+  for( p = 0; p < OLED_EMU_MAX_PAGE; p++ )
+  {
+    memcpy(&fb[p * width], emu.ram[p], width);
+  }
+  spin_unlock_irqrestore(&emu_lock, flags);
+
+  ret = simple_read_from_buffer(buf, len, off, fb, OLED_EMU_MAX_PAGE * width);
+  kfree(fb);
+
+  return ret;
+}
+
+static const struct file_operations oled_emu_fb_fops =
+{
+  .owner  = THIS_MODULE,
+  .read   = oled_emu_fb_read,
+  .llseek = default_llseek,
+};
+
+static int oled_emu_stats_show(struct seq_file *m, void *v)
+{
+  static const char * const modes[] = { "horizontal", "vertical", "page", "invalid" };
+  struct oled_emu_state *s;
+  unsigned long flags;
+
+  /* snapshot, seq_printf may sleep */
+  s = kmalloc(sizeof(*s), GFP_KERNEL);
+  if( !s )
+  {
+    return -ENOMEM;
+  }
+  spin_lock_irqsave(&emu_lock, flags);
+  *s = emu;
+  spin_unlock_irqrestore(&emu_lock, flags);
+
+  seq_printf(m, "controller:  %s\n",   emu_ssd1315 ? "SSD1315" : "SH1106");
+  seq_printf(m, "max_speed:   %u\n",   emu_max_speed_hz);
+  seq_printf(m, "messages:    %llu\n", s->msgs);
+  seq_printf(m, "transfers:   %llu\n", s->xfers);
+  seq_printf(m, "bytes:       %llu\n", s->bytes);
+  seq_printf(m, "data_bytes:  %llu\n", s->data_bytes);
+  seq_printf(m, "cmd_bytes:   %llu\n", s->cmd_bytes);
+  seq_printf(m, "bus_us:      %llu\n", div_u64(s->bus_ns, NSEC_PER_USEC));
+  seq_printf(m, "max_msg_us:  %u\n",   s->max_msg_ns / NSEC_PER_USEC);
+  seq_printf(m, "dc_edges:    %llu\n", s->dc_edges);
+  seq_printf(m, "resets:      %llu\n", s->resets);
+  seq_printf(m, "mode:        %s\n",   modes[s->mode & 0x03]);
+  seq_printf(m, "pointer:     col %u page %u\n", s->col, s->page);
+  seq_printf(m, "display:     %s%s contrast 0x%02x\n",
+             s->display_on ? "on" : "off", s->inverted ? " inverted" : "", s->contrast);
+
+  kfree(s);
+
+  return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(oled_emu_stats);
+
+/* oldest first: start time (us, relative to the oldest), size, simulated bus time */
+static int oled_emu_timing_show(struct seq_file *m, void *v)
+{
+  struct oled_emu_record *rec;
+  unsigned long flags;
+  unsigned int  i, head;
+  ktime_t       t0 = 0;
+
+  rec = kmalloc_array(OLED_EMU_NR_RECORDS, sizeof(*rec), GFP_KERNEL);
+  if( !rec )
+  {
+    return -ENOMEM;
+  }
+  spin_lock_irqsave(&emu_lock, flags);
+  memcpy(rec, emu.rec, sizeof(emu.rec));
+  head = emu.rec_head;
+  spin_unlock_irqrestore(&emu_lock, flags);
+
+  seq_puts(m, "start_us  bytes  xfers  dc_edges  bus_us\n");
+  for( i = 0; i < OLED_EMU_NR_RECORDS; i++ )
+  {
+    struct oled_emu_record *r = &rec[( head + i ) % OLED_EMU_NR_RECORDS];
+
+    if( !r->xfers )
+    {
+      continue;
+    }
+    if( !t0 )
+    {
+      t0 = r->at;
+    }
+    seq_printf(m, "%8lld  %5u  %5u  %8u  %6u\n",
+               ktime_us_delta(r->at, t0), r->bytes, r->xfers, r->dc_edges, r->bus_ns / NSEC_PER_USEC);
+  }
+
+  kfree(rec);
+
+  return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(oled_emu_timing);
+
+static ssize_t oled_emu_reset_write(struct file *filp, const char __user *buf, size_t len, loff_t *off)
+{
+  unsigned long flags;
+
+  spin_lock_irqsave(&emu_lock, flags);
+
+  emu.msgs       = 0;
+  emu.xfers      = 0;
+  emu.bytes      = 0;
+  emu.data_bytes = 0;
+  emu.cmd_bytes  = 0;
+  emu.bus_ns     = 0;
+  emu.max_msg_ns = 0;
+  emu.dc_edges   = 0;
+  emu.resets     = 0;
+  memset(emu.rec, 0, sizeof(emu.rec));
+
+  spin_unlock_irqrestore(&emu_lock, flags);
+
+  return len;
+}
+
+static const struct file_operations oled_emu_reset_fops =
+{
+  .owner = THIS_MODULE,
+  .write = oled_emu_reset_write,
+};
+
+/******************************************************************************************************/
+
+/* module init func */
+static int __init oled_spi_emu_init(void)
+{
+  int ret;
+
+  pr_info("\n@frk: going to init...");
+
+  OledEmu_Reset(&emu);
+  emu.dc  = 1;
+  emu.rst = 1;
+
+  emu_pdev = platform_device_register_simple("oled_spi_emu", -1, NULL, 0);
+  if( IS_ERR(emu_pdev) )
+  {
+    pr_err("\n Cannot register the platform device. ");
+    return PTR_ERR(emu_pdev);
+  }
+
+  /* RST/DC lines */
+  emu_gpio.label            = "oled_spi_emu";
+  emu_gpio.parent           = &emu_pdev->dev;
+  emu_gpio.owner            = THIS_MODULE;
+  emu_gpio.base             = emu_gpio_base;
+  emu_gpio.ngpio            = 2;
+  emu_gpio.names            = oled_emu_gpio_names;
+  emu_gpio.can_sleep        = false;
+  emu_gpio.get              = oled_emu_gpio_get;
+  emu_gpio.set              = oled_emu_gpio_set;
+  emu_gpio.direction_output = oled_emu_gpio_direction_output;
+  emu_gpio.get_direction    = oled_emu_gpio_get_direction;
+
+  ret = gpiochip_add_data(&emu_gpio, NULL);
+  if( ret < 0 )
+  {
+    pr_err("\n Cannot add the gpio chip. ");
+    goto r_pdev;
+  }
+
+  /* SPI controller */
+  emu_ctlr = spi_alloc_master(&emu_pdev->dev, 0);
+  if( !emu_ctlr )
+  {
+    ret = -ENOMEM;
+    goto r_gpio;
+  }
+
+  emu_ctlr->bus_num              = emu_bus;
+  emu_ctlr->num_chipselect       = 4;
+  emu_ctlr->mode_bits            = SPI_CPOL | SPI_CPHA | SPI_3WIRE | SPI_CS_HIGH;
+  emu_ctlr->bits_per_word_mask   = SPI_BPW_MASK(8) | SPI_BPW_MASK(9);
+  emu_ctlr->max_speed_hz         = emu_max_speed_hz;
+  emu_ctlr->transfer_one_message = oled_emu_transfer_one_message;
+
+  ret = spi_register_controller(emu_ctlr);
+  if( ret < 0 )
+  {
+    pr_err("\n Cannot register SPI bus %d. ", emu_bus);
+    spi_controller_put(emu_ctlr);
+    goto r_gpio;
+  }
+
+  emu_debugfs = debugfs_create_dir("oled_spi_emu", NULL);
+  debugfs_create_file("fb",     0444, emu_debugfs, NULL, &oled_emu_fb_fops);
+  debugfs_create_file("stats",  0444, emu_debugfs, NULL, &oled_emu_stats_fops);
+  debugfs_create_file("timing", 0444, emu_debugfs, NULL, &oled_emu_timing_fops);
+  debugfs_create_file("reset",  0200, emu_debugfs, NULL, &oled_emu_reset_fops);
+
+  pr_info("\n @frk: %s emulator on SPI bus %d, RST gpio %d, DC gpio %d ... DONE!!! \n",
+          emu_ssd1315 ? "SSD1315" : "SH1106", emu_bus,
+          emu_gpio.base + OLED_EMU_GPIO_RST, emu_gpio.base + OLED_EMU_GPIO_DC);
+  return 0;
+
+r_gpio:
+  gpiochip_remove(&emu_gpio);
+r_pdev:
+  platform_device_unregister(emu_pdev);
+  return ret;
+}
+
+/* module exit func*/
+static void __exit oled_spi_emu_exit(void)
+{
+  debugfs_remove_recursive(emu_debugfs);
+  spi_unregister_controller(emu_ctlr);
+  gpiochip_remove(&emu_gpio);
+  platform_device_unregister(emu_pdev);
+
+  pr_info("\n @frk: SPI-oled emulator remove ... DONE!!! \n");
+}
+
+/******************************************************************************************************/
+module_init(oled_spi_emu_init);
+module_exit(oled_spi_emu_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("FRANK <frank@bos-semi.com>");
+MODULE_DESCRIPTION("SH1106/SSD1315 SPI EMULATOR");
+MODULE_VERSION("1.0");
+
+/******************************************************************************************************/
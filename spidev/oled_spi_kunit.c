@@ -0,0 +1,166 @@
+/***************************************************************************************************//**
+*  \file       oled_spi_kunit.c
+*
+*  \details    KUnit test of the SSH1106 row-major <-> page-major conversion (oled_transpose.h)
+*
+*  \author     Frank
+*
+*  Built when the kernel has CONFIG_KUNIT; run with
+*    insmod oled_spi_kunit.ko && dmesg | grep -A20 oled_transpose
+*
+******************************************************************************************************/
+#include <kunit/test.h>
+#include <linux/module.h>
+#include <linux/random.h>
+
+#include "oled_transpose.h"
+
+#define OLED_KUNIT_BLOCKS       ( 1000 )          // random 8x8 blocks per run
+#define OLED_KUNIT_FRAMES       (   16 )          // random frames per run
+
+/* per-pixel conversion: pixel (x, y) goes from the row bit to the page bit */
+static void oled_kunit_rows_to_pages(uint8_t (*rows)[SSH1106_ROW_BYTES], uint8_t (*pages)[SSH1106_MAX_SEG])
+{
+  unsigned int x, y;
+
+  memset(pages, 0, SSH1106_MAX_PAGE * SSH1106_MAX_SEG);
+  for( y = 0; y < SSH1106_MAX_PAGE * 8; y++ )
+  {
+    for( x = 0; x < SSH1106_MAX_SEG; x++ )
+    {
+      if( rows[y][x / 8] & ( 0x80 >> ( x % 8 ) ) )
+      {
+        pages[y / 8][x] |= 1u << ( y % 8 );
+      }
+    }
+  }
+}
+
+/* random row-major frame, the unused bits at the end of each row left 0 */
+static void oled_kunit_random_rows(uint8_t (*rows)[SSH1106_ROW_BYTES])
+{
+  unsigned int y;
+
+  get_random_bytes(rows, SSH1106_MAX_PAGE * 8 * SSH1106_ROW_BYTES);
+  for( y = 0; y < SSH1106_MAX_PAGE * 8; y++ )
+  {
+    rows[y][SSH1106_ROW_BYTES - 1] &= 0xFF << ( ( SSH1106_ROW_BYTES * 8 ) - SSH1106_MAX_SEG );
+  }
+}
+
+/* Transpose8: bit j of out[i * out_step] is bit i of in[j * in_step] */
+static void oled_kunit_transpose8(struct kunit *test)
+{
+  uint8_t      in[8];
+  uint8_t      out[8];
+  uint8_t      back[8];
+  uint8_t      expect;
+  unsigned int n, i, j;
+
+  for( n = 0; n < OLED_KUNIT_BLOCKS; n++ )
+  {
+    get_random_bytes(in, sizeof(in));
+    ETX_SSH1106_Transpose8(in, 1, out, 1);
+
+    for( i = 0; i < 8; i++ )
+    {
+      expect = 0;
+      for( j = 0; j < 8; j++ )
+      {
+        expect |= ( ( in[j] >> i ) & 1 ) << j;
+      }
+      KUNIT_ASSERT_EQ_MSG(test, out[i], expect, "block %u byte %u", n, i);
+    }
+
+    //its own inverse
+    ETX_SSH1106_Transpose8(out, 1, back, 1);
+    KUNIT_ASSERT_EQ(test, memcmp(in, back, sizeof(in)), 0);
+  }
+}
+
+/* RowsToPages gives the per-pixel result, whole frame and page ranges */
+static void oled_kunit_rows_to_pages_naive(struct kunit *test)
+{
+  uint8_t      (*rows)[SSH1106_ROW_BYTES];
+  uint8_t      (*fast)[SSH1106_MAX_SEG];
+  uint8_t      (*slow)[SSH1106_MAX_SEG];
+  unsigned int   n;
+  uint8_t        first, last;
+
+  rows = kunit_kzalloc(test, SSH1106_MAX_PAGE * 8 * SSH1106_ROW_BYTES, GFP_KERNEL);
+  fast = kunit_kzalloc(test, SSH1106_MAX_PAGE * SSH1106_MAX_SEG, GFP_KERNEL);
+  slow = kunit_kzalloc(test, SSH1106_MAX_PAGE * SSH1106_MAX_SEG, GFP_KERNEL);
+  KUNIT_ASSERT_NOT_ERR_OR_NULL(test, rows);
+  KUNIT_ASSERT_NOT_ERR_OR_NULL(test, fast);
+  KUNIT_ASSERT_NOT_ERR_OR_NULL(test, slow);
+
+  for( n = 0; n < OLED_KUNIT_FRAMES; n++ )
+  {
+    oled_kunit_random_rows(rows);
+    oled_kunit_rows_to_pages(rows, slow);
+
+    ETX_SSH1106_RowsToPages(rows, fast, 0, SSH1106_MAX_PAGE - 1);
+    KUNIT_ASSERT_EQ_MSG(test, memcmp(fast, slow, SSH1106_MAX_PAGE * SSH1106_MAX_SEG), 0, "frame %u", n);
+
+    //a range only writes its own pages
+    first = n % SSH1106_MAX_PAGE;
+    last  = first + ( ( n / SSH1106_MAX_PAGE ) % ( SSH1106_MAX_PAGE - first ) );
+    memset(fast, 0, SSH1106_MAX_PAGE * SSH1106_MAX_SEG);
+    memset(slow, 0, first * SSH1106_MAX_SEG);
+    memset(slow[last + 1], 0, ( SSH1106_MAX_PAGE - 1 - last ) * SSH1106_MAX_SEG);
+    ETX_SSH1106_RowsToPages(rows, fast, first, last);
+    KUNIT_ASSERT_EQ_MSG(test, memcmp(fast, slow, SSH1106_MAX_PAGE * SSH1106_MAX_SEG), 0,
+                        "frame %u pages %u..%u", n, first, last);
+  }
+}
+
+/* RowsToPages and PagesToRows undo each other */
+static void oled_kunit_round_trip(struct kunit *test)
+{
+  uint8_t      (*rows)[SSH1106_ROW_BYTES];
+  uint8_t      (*back)[SSH1106_ROW_BYTES];
+  uint8_t      (*pages)[SSH1106_MAX_SEG];
+  uint8_t      (*again)[SSH1106_MAX_SEG];
+  unsigned int   n;
+
+  rows  = kunit_kzalloc(test, SSH1106_MAX_PAGE * 8 * SSH1106_ROW_BYTES, GFP_KERNEL);
+  back  = kunit_kzalloc(test, SSH1106_MAX_PAGE * 8 * SSH1106_ROW_BYTES, GFP_KERNEL);
+  pages = kunit_kzalloc(test, SSH1106_MAX_PAGE * SSH1106_MAX_SEG, GFP_KERNEL);
+  again = kunit_kzalloc(test, SSH1106_MAX_PAGE * SSH1106_MAX_SEG, GFP_KERNEL);
+  KUNIT_ASSERT_NOT_ERR_OR_NULL(test, rows);
+  KUNIT_ASSERT_NOT_ERR_OR_NULL(test, back);
+  KUNIT_ASSERT_NOT_ERR_OR_NULL(test, pages);
+  KUNIT_ASSERT_NOT_ERR_OR_NULL(test, again);
+
+  for( n = 0; n < OLED_KUNIT_FRAMES; n++ )
+  {
+    //rows -> pages -> rows
+    oled_kunit_random_rows(rows);
+    ETX_SSH1106_RowsToPages(rows, pages, 0, SSH1106_MAX_PAGE - 1);
+    ETX_SSH1106_PagesToRows(pages, back, 0, SSH1106_MAX_PAGE - 1);
+    KUNIT_ASSERT_EQ_MSG(test, memcmp(rows, back, SSH1106_MAX_PAGE * 8 * SSH1106_ROW_BYTES), 0, "frame %u", n);
+
+    //pages -> rows -> pages, every page bit is a pixel
+    get_random_bytes(pages, SSH1106_MAX_PAGE * SSH1106_MAX_SEG);
+    ETX_SSH1106_PagesToRows(pages, back, 0, SSH1106_MAX_PAGE - 1);
+    ETX_SSH1106_RowsToPages(back, again, 0, SSH1106_MAX_PAGE - 1);
+    KUNIT_ASSERT_EQ_MSG(test, memcmp(pages, again, SSH1106_MAX_PAGE * SSH1106_MAX_SEG), 0, "frame %u", n);
+  }
+}
+
+static struct kunit_case oled_transpose_cases[] = {
+  KUNIT_CASE(oled_kunit_transpose8),
+  KUNIT_CASE(oled_kunit_rows_to_pages_naive),
+  KUNIT_CASE(oled_kunit_round_trip),
+  {}
+};
+
+static struct kunit_suite oled_transpose_suite = {
+  .name       = "oled_transpose",
+  .test_cases = oled_transpose_cases,
+};
+kunit_test_suite(oled_transpose_suite);
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("FRANK <frank@bos-semi.com>");
+MODULE_DESCRIPTION("SSH1106 ROW/PAGE CONVERSION KUNIT TEST");
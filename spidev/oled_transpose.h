@@ -0,0 +1,131 @@
+/***************************************************************************************************//**
+*  \file       oled_transpose.h
+*
+*  \details    SSH1106 row-major <-> page-major 1bpp conversion, shared by the
+*              driver and its KUnit test (oled_spi_kunit.c)
+*
+*  \author     Frank
+*
+******************************************************************************************************/
+#ifndef OLED_TRANSPOSE_H
+#define OLED_TRANSPOSE_H
+
+#include <linux/kernel.h>
+#include <linux/types.h>
+#include <linux/string.h>
+
+#define SSH1106_MAX_SEG         ( 132 )           // Maximum segment
+#define SSH1106_MAX_PAGE        (   8 )           // Number of pages (lines)
+
+/*
+** Row-major 1bpp image: the usual bitmap layout, 64 rows of
+** SSH1106_ROW_BYTES bytes, bit 7 = leftmost pixel, the last 4 bits of a
+** row unused. It is converted from/to the page-major panel RAM layout by
+** an 8x8 bit transpose per block of 8 rows x 8 columns.
+*/
+#define SSH1106_ROW_BYTES       ( DIV_ROUND_UP( SSH1106_MAX_SEG, 8 ) )
+
+/****************************************************************************
+ * Name: ETX_SSH1106_Transpose8
+ *
+ * Details : This function transposes an 8x8 bit block in a 64-bit word
+ *           (three swap steps of 4x4, 2x2 and 1x1 sub-blocks, Hacker's
+ *           Delight 7-3). Byte i of the word is loaded from in[i * in_step]
+ *           and stored to out[i * out_step]. Row bytes (bit 7 = left) in
+ *           forward order give the column bytes (bit 0 = top) from the
+ *           right, so the page side is always walked backwards.
+ *
+ * Argument:
+ *              in/in_step   -> first source byte, distance to the next one
+ *              out/out_step -> first destination byte, distance to the next one
+ * 
+ ****************************************************************************/
+static inline void ETX_SSH1106_Transpose8( const uint8_t *in, int in_step, uint8_t *out, int out_step )
+{
+  u64 x = 0;
+  u64 t;
+  int i;
+
+  for( i = 0; i < 8; i++ )
+  {
+    x |= (u64)in[i * in_step] << ( 8 * i );
+  }
+
+  t = ( x ^ ( x >>  7 ) ) & 0x00AA00AA00AA00AAULL;
+  x = x ^ t ^ ( t <<  7 );
+  t = ( x ^ ( x >> 14 ) ) & 0x0000CCCC0000CCCCULL;
+  x = x ^ t ^ ( t << 14 );
+  t = ( x ^ ( x >> 28 ) ) & 0x00000000F0F0F0F0ULL;
+  x = x ^ t ^ ( t << 28 );
+
+  for( i = 0; i < 8; i++ )
+  {
+    out[i * out_step] = x >> ( 8 * i );
+  }
+}
+
+/****************************************************************************
+ * Name: ETX_SSH1106_RowsToPages
+ *
+ * Details : This function converts pages first..last of a row-major image
+ *           to page-major, 8x8 pixels at a time. The last block of a page
+ *           only has 4 columns (132 = 16 * 8 + 4).
+ *
+ * Argument:
+ *              rows  -> row-major image, SSH1106_ROW_BYTES per row
+ *              pages -> page-major image, SSH1106_MAX_SEG per page
+ *              first -> first page
+ *              last  -> last page
+ * 
+ ****************************************************************************/
+static inline void ETX_SSH1106_RowsToPages( uint8_t (*rows)[SSH1106_ROW_BYTES], uint8_t (*pages)[SSH1106_MAX_SEG],
+                                     uint8_t first, uint8_t last )
+{
+  uint8_t      tail[8];
+  uint8_t      page;
+  unsigned int blk;
+
+  for( page = first; page <= last; page++ )
+  {
+    for( blk = 0; blk < SSH1106_MAX_SEG / 8; blk++ )
+    {
+      ETX_SSH1106_Transpose8( &rows[page * 8][blk], SSH1106_ROW_BYTES, &pages[page][( blk * 8 ) + 7], -1 );
+    }
+    ETX_SSH1106_Transpose8( &rows[page * 8][blk], SSH1106_ROW_BYTES, &tail[7], -1 );
+    memcpy( &pages[page][blk * 8], tail, SSH1106_MAX_SEG % 8 );
+  }
+}
+
+/****************************************************************************
+ * Name: ETX_SSH1106_PagesToRows
+ *
+ * Details : This function converts pages first..last of a page-major
+ *           image to row-major, the inverse of ETX_SSH1106_RowsToPages.
+ *           The unused bits at the end of a row are left 0.
+ *
+ * Argument:
+ *              pages -> page-major image, SSH1106_MAX_SEG per page
+ *              rows  -> row-major image, SSH1106_ROW_BYTES per row
+ *              first -> first page
+ *              last  -> last page
+ * 
+ ****************************************************************************/
+static inline void ETX_SSH1106_PagesToRows( uint8_t (*pages)[SSH1106_MAX_SEG], uint8_t (*rows)[SSH1106_ROW_BYTES],
+                                     uint8_t first, uint8_t last )
+{
+  uint8_t      tail[8] = { 0 };
+  uint8_t      page;
+  unsigned int blk;
+
+  for( page = first; page <= last; page++ )
+  {
+    for( blk = 0; blk < SSH1106_MAX_SEG / 8; blk++ )
+    {
+      ETX_SSH1106_Transpose8( &pages[page][( blk * 8 ) + 7], -1, &rows[page * 8][blk], SSH1106_ROW_BYTES );
+    }
+    memcpy( tail, &pages[page][blk * 8], SSH1106_MAX_SEG % 8 );
+    ETX_SSH1106_Transpose8( &tail[7], -1, &rows[page * 8][blk], SSH1106_ROW_BYTES );
+  }
+}
+
+#endif /* OLED_TRANSPOSE_H */